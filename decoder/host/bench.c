@@ -0,0 +1,367 @@
+// Plays a video.bin through the real player on a PC, as fast as the host can go,
+// and reports what the video would cost on the calculator. The player is main.c
+// as-is, built against the stubbed libraries in include/ and host.c.
+//
+// The cycle model is rough, it's meant for comparing videos and player builds
+// against each other rather than predicting hardware to the cycle. Each fill
+// costs a fixed amount for the call and reading its rectangle, then some per
+// row and per byte written, depending on the fill backend.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host.h"
+
+static void host_fill(int x, int y, int width, int height);
+static void host_frame(int frame_number, const unsigned char* cursor);
+static inline void host_copy(int size);
+static void host_start(void);
+
+#define VID84_FILL_HOOK(x, y, width, height)    host_fill(x, y, width, height)
+#define VID84_FRAME_HOOK(frame_number, cursor)  host_frame(frame_number, cursor)
+#define VID84_COPY_HOOK(size)                   host_copy(size)
+#define VID84_START_HOOK()                      host_start()
+#define VID84_VIDEO_HEADER                      "host_video.h"
+
+#define main vid84_main
+#include "../src/main.c"
+#undef main
+
+// ----------------------------
+// Cycle model
+// ----------------------------
+
+#if VID84_LCD_1BPP
+#define HOST_CYCLES_PER_FILL        300     // Masks and pointer math.
+#define HOST_CYCLES_PER_ROW         90      // Both edge bytes, plus the memset call.
+#define HOST_BYTES_PER_ROW(width)   ((width) / 8 + 1)
+#elif VID84_FILL_BACKEND == FILL_BACKEND_SPANS
+#define HOST_CYCLES_PER_FILL        250
+#define HOST_CYCLES_PER_ROW         60      // A memset call per row.
+#define HOST_BYTES_PER_ROW(width)   (width)
+#elif VID84_FILL_BACKEND == FILL_BACKEND_NOCLIP
+#define HOST_CYCLES_PER_FILL        400
+#define HOST_CYCLES_PER_ROW         30
+#define HOST_BYTES_PER_ROW(width)   (width)
+#else
+#define HOST_CYCLES_PER_FILL        550     // Clipping it first.
+#define HOST_CYCLES_PER_ROW         30
+#define HOST_BYTES_PER_ROW(width)   (width)
+#endif
+// Writes to VRAM have wait states on top of the two cycles ldir takes.
+#define HOST_CYCLES_PER_BYTE        3
+// Copying a prerendered frame in reads VRAM too.
+#define HOST_CYCLES_PER_COPY_BYTE   4
+
+// ----------------------------
+// Per-frame books
+// ----------------------------
+
+typedef struct {
+    int number;                 // Frame time it went up in, from 0, so it lines up with the reference.
+    uint32_t bytes;             // Video data it took up, including any frames dropped right before it.
+                                // Decompressed, for compressed videos.
+    uint32_t fills;
+    uint32_t pixels;
+    uint32_t cycles;            // Modeled eZ80 cycles spent on it, not counting waiting on timers.
+    uint32_t dropped;           // Frames skipped right before it.
+    uint32_t mismatched;        // Pixels that don't match the reference frame, if there is one.
+} host_frame_t;
+
+static host_frame_t* frames = NULL;
+static int frame_count = 0;
+static int frame_capacity = 0;
+
+static host_frame_t current_frame;
+static int last_offset = 0;
+static int last_frame_number = 0;
+static uint64_t last_busy_cycles = 0;
+
+static FILE* canvas_output = NULL;
+static FILE* reference_input = NULL;
+static uint8_t canvas[240 * 240];
+static uint8_t reference[240 * 240];
+static int reference_frames = 0;       // Frames compared, the reference can run out first.
+
+static void host_fill(int x, int y, int width, int height)
+{
+    (void)x;
+    (void)y;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    current_frame.fills++;
+    current_frame.pixels += (uint32_t)(width * height);
+    host_cycles += HOST_CYCLES_PER_FILL + (uint64_t)height * (HOST_CYCLES_PER_ROW + HOST_CYCLES_PER_BYTE * HOST_BYTES_PER_ROW(width));
+}
+
+static inline void host_copy(int size)
+{
+    host_cycles += (uint64_t)size * HOST_CYCLES_PER_COPY_BYTE;
+}
+
+// Everything before the clock starts happens while the prompt is up, so it doesn't
+// count towards the first frame.
+static void host_start(void)
+{
+    memset(&current_frame, 0, sizeof(current_frame));
+    last_busy_cycles = host_cycles - host_idle_cycles;
+}
+
+static void host_frame(int frame_number, const unsigned char* cursor)
+{
+    uint64_t busy_cycles = host_cycles - host_idle_cycles;
+
+    int offset = video_offset(cursor);
+
+    // Bad data ends the video on something with no offset, and it didn't use anything up.
+    current_frame.bytes = (offset > last_offset) ? (uint32_t)(offset - last_offset) : 0;
+    current_frame.cycles = (uint32_t)(busy_cycles - last_busy_cycles);
+    // The hook runs before the player drops anything, so a skip shows up here on
+    // the next frame shown, along with the bytes it skipped over.
+    current_frame.number = frame_number - 1;
+    current_frame.dropped = (uint32_t)(frame_number - last_frame_number - 1);
+
+    if (canvas_output != NULL || reference_input != NULL)
+        host_capture_canvas(canvas);
+
+    if (canvas_output != NULL)
+        fwrite(canvas, 1, sizeof(canvas), canvas_output);
+
+    // Frame numbers count frame times, the same as the reference does.
+    if (reference_input != NULL && fseek(reference_input, (long)(frame_number - 1) * sizeof(reference), SEEK_SET) == 0 &&
+    fread(reference, 1, sizeof(reference), reference_input) == sizeof(reference)) {
+        for (size_t i = 0; i < sizeof(canvas); i++)
+            current_frame.mismatched += (canvas[i] != reference[i]);
+        reference_frames++;
+    }
+
+    if (frame_count == frame_capacity) {
+        frame_capacity = (frame_capacity == 0) ? 1024 : frame_capacity * 2;
+        frames = realloc(frames, sizeof(host_frame_t) * frame_capacity);
+        if (frames == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+    }
+    frames[frame_count++] = current_frame;
+
+    memset(&current_frame, 0, sizeof(current_frame));
+    if (offset > last_offset)
+        last_offset = offset;
+    last_frame_number = frame_number;
+    last_busy_cycles = busy_cycles;
+}
+
+// ----------------------------
+// Benchmark
+// ----------------------------
+
+unsigned char* video_bin = NULL;
+unsigned int video_bin_len = 0;
+
+static int compare_uint32(const void* a, const void* b)
+{
+    uint32_t left = *(const uint32_t*)a;
+    uint32_t right = *(const uint32_t*)b;
+    return (left > right) - (left < right);
+}
+
+static bool load_video(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    video_bin = malloc(size > 0 ? size : 1);
+    bool read = video_bin != NULL && fread(video_bin, 1, size, file) == (size_t)size;
+    video_bin_len = (unsigned int)size;
+
+    fclose(file);
+    return read;
+}
+
+static bool write_file(const char* path, const void* data, size_t size)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+static void write_frame_csv(FILE* file)
+{
+    fprintf(file, "frame,bytes,fills,pixels,cycles,dropped,mismatched\n");
+    for (int i = 0; i < frame_count; i++) {
+        fprintf(file, "%d,%u,%u,%u,%u,%u,%u\n", frames[i].number, (unsigned int)frames[i].bytes, (unsigned int)frames[i].fills,
+        (unsigned int)frames[i].pixels, (unsigned int)frames[i].cycles, (unsigned int)frames[i].dropped,
+        (unsigned int)frames[i].mismatched);
+    }
+}
+
+// The pth percentile of a sorted list.
+static uint32_t percentile(const uint32_t* sorted, int count, int p)
+{
+    int i = (count * p) / 100;
+    return (count > 0) ? sorted[i < count ? i : count - 1] : 0;
+}
+
+static void print_report(const char* path, double host_seconds)
+{
+    uint64_t total_cycles = 0, total_fills = 0, total_pixels = 0, total_bytes = 0, total_mismatched = 0;
+    unsigned int dropped = 0, over_budget = 0, mismatched_frames = 0;
+    uint32_t budget = HOST_CLOCK_HZ / video_fps;
+    int slowest = 0;
+
+    uint32_t* sorted = malloc(sizeof(uint32_t) * (frame_count > 0 ? frame_count : 1));
+    for (int i = 0; i < frame_count; i++) {
+        total_cycles += frames[i].cycles;
+        total_fills += frames[i].fills;
+        total_pixels += frames[i].pixels;
+        total_bytes += frames[i].bytes;
+        dropped += frames[i].dropped;
+        if (frames[i].cycles > budget)
+            over_budget++;
+        if (frames[i].cycles > frames[slowest].cycles)
+            slowest = i;
+        if (frames[i].mismatched > 0)
+            mismatched_frames++;
+        total_mismatched += frames[i].mismatched;
+        sorted[i] = frames[i].fills;
+    }
+    qsort(sorted, frame_count, sizeof(uint32_t), compare_uint32);
+    uint32_t p99_fills = percentile(sorted, frame_count, 99);
+
+    for (int i = 0; i < frame_count; i++)
+        sorted[i] = frames[i].cycles;
+    qsort(sorted, frame_count, sizeof(uint32_t), compare_uint32);
+
+    int count = (frame_count > 0) ? frame_count : 1;
+    uint64_t average = total_cycles / count;
+
+    printf("%s: version %d, %dfps, scale %d, %u bytes\n", path, (int)video_version, (int)video_fps,
+    (int)video_scale_factor, video_bin_len);
+    printf("Frames:     %d shown, %u dropped, %u over the %u cycle budget\n", frame_count, dropped, over_budget,
+    (unsigned int)budget);
+    printf("Cycles:     %llu average (%.1f%% of budget), %u p95, %u max (frame %d)\n", (unsigned long long)average,
+    100.0 * average / budget, (unsigned int)percentile(sorted, frame_count, 95),
+    (unsigned int)(frame_count > 0 ? frames[slowest].cycles : 0), slowest);
+    printf("Per frame:  %.1f fills (%u p99), %.0f pixels, %.1f bytes\n", (double)total_fills / count,
+    (unsigned int)p99_fills, (double)total_pixels / count, (double)total_bytes / count);
+    printf("Modeled:    %.1f fps at most, %.1f seconds of playback\n",
+    average ? (double)HOST_CLOCK_HZ / average : 0.0, (double)host_cycles / HOST_CLOCK_HZ);
+    printf("Host:       %.1f frames/sec (%.3f seconds)\n", host_seconds > 0 ? frame_count / host_seconds : 0.0,
+    host_seconds);
+
+    if (reference_input != NULL) {
+        printf("Reference:  %llu pixels off in %u of %d frames compared (%.4f%% of pixels)\n",
+        (unsigned long long)total_mismatched, mismatched_frames, reference_frames,
+        reference_frames ? 100.0 * total_mismatched / ((double)reference_frames * sizeof(canvas)) : 0.0);
+    }
+
+    free(sorted);
+}
+
+static void print_usage(void)
+{
+    fprintf(stderr, "usage: bench [-v] [-o frames.raw] [-r reference.raw] [-c frames.csv] [-t telemetry.bin] video.bin\n");
+    fprintf(stderr, "  -o  write every frame as shown, as 240x240 bytes of 0 (black) or 255 (white)\n");
+    fprintf(stderr, "  -r  count pixels that differ from these frames, in the same layout as -o\n");
+    fprintf(stderr, "  -c  write per-frame stats as CSV\n");
+    fprintf(stderr, "  -t  write the telemetry AppVar the player saved (VID84_TELEMETRY=1 builds)\n");
+    fprintf(stderr, "  -v  print what the player puts on screen\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* video_path = NULL;
+    const char* canvas_path = NULL;
+    const char* reference_path = NULL;
+    const char* csv_path = NULL;
+    const char* telemetry_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v"))
+            host_verbose = true;
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            canvas_path = argv[++i];
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            reference_path = argv[++i];
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            csv_path = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            telemetry_path = argv[++i];
+        else if (argv[i][0] != '-' && video_path == NULL)
+            video_path = argv[i];
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (video_path == NULL) {
+        print_usage();
+        return 1;
+    }
+
+    if (!load_video(video_path)) {
+        fprintf(stderr, "Couldn't read %s.\n", video_path);
+        return 1;
+    }
+
+    if (canvas_path != NULL && (canvas_output = fopen(canvas_path, "wb")) == NULL) {
+        fprintf(stderr, "Couldn't open %s.\n", canvas_path);
+        return 1;
+    }
+
+    if (reference_path != NULL && (reference_input = fopen(reference_path, "rb")) == NULL) {
+        fprintf(stderr, "Couldn't open %s.\n", reference_path);
+        return 1;
+    }
+
+    clock_t start = clock();
+    int result = vid84_main();
+    double host_seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    if (canvas_output != NULL)
+        fclose(canvas_output);
+    if (reference_input != NULL)
+        fclose(reference_input);
+
+    if (result != 0) {
+        fprintf(stderr, "The player rejected %s.\n", video_path);
+        return 1;
+    }
+
+    if (!host_lcd_restored()) {
+        fprintf(stderr, "The player left the LCD in 1bpp mode.\n");
+        return 1;
+    }
+
+    print_report(video_path, host_seconds);
+
+    if (csv_path != NULL) {
+        FILE* file = fopen(csv_path, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Couldn't open %s.\n", csv_path);
+            return 1;
+        }
+        write_frame_csv(file);
+        fclose(file);
+    }
+
+    if (telemetry_path != NULL && !write_file(telemetry_path, host_appvar_data, host_appvar_size)) {
+        fprintf(stderr, "Couldn't write %s.\n", telemetry_path);
+        return 1;
+    }
+
+    return 0;
+}
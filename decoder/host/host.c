@@ -0,0 +1,346 @@
+// Stubbed CE libraries for running the player on a PC. graphx draws into plain
+// memory buffers, the LCD registers are variables, and the timers count the
+// modeled eZ80 cycles in host_cycles instead of real time.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <compression.h>
+#include <fileioc.h>
+#include <graphx.h>
+#include <keypadc.h>
+#include <sys/lcd.h>
+#include <sys/timers.h>
+#include <ti/getcsc.h>
+
+#include "host.h"
+
+#define LCD_CONTROL_BPP_MASK        0x00E
+#define LCD_CONTROL_8BPP            0x006
+#define LCD_CONTROL_16BPP           0x00C
+
+uint64_t host_cycles = 0;
+uint64_t host_idle_cycles = 0;
+bool host_verbose = false;
+
+unsigned char* host_appvar_data = NULL;
+size_t host_appvar_size = 0;
+
+// ----------------------------
+// LCD
+// ----------------------------
+
+uint8_t host_lcd_ram[320 * 240 * 2];
+uintptr_t host_lcd_upbase;
+uint32_t host_lcd_control = 0x92C;  // 16bpp, how the OS leaves it.
+uint16_t host_lcd_palette[256];
+uint8_t host_lcd_int_acknowledge;
+
+bool host_lcd_restored(void)
+{
+    return (host_lcd_control & LCD_CONTROL_BPP_MASK) != 0;
+}
+
+// ----------------------------
+// graphx
+// ----------------------------
+
+// Same as graphx, both buffers live in VRAM and the screen is the one the LCD points at.
+#define HOST_BUFFER(n)              ((uint8_t (*)[GFX_LCD_WIDTH])(host_lcd_ram + (n) * GFX_LCD_WIDTH * GFX_LCD_HEIGHT))
+
+uint8_t (*host_vbuffer)[GFX_LCD_WIDTH];
+static int screen_buffer = 0;
+static uint8_t color_index = 0;
+
+void gfx_Begin(void)
+{
+    memset(host_lcd_ram, 255, sizeof(host_lcd_ram));
+    screen_buffer = 0;
+    host_vbuffer = HOST_BUFFER(0);
+    host_lcd_upbase = (uintptr_t)HOST_BUFFER(0);
+    host_lcd_control = (host_lcd_control & ~LCD_CONTROL_BPP_MASK) | LCD_CONTROL_8BPP;
+}
+
+void gfx_End(void)
+{
+    host_lcd_upbase = (uintptr_t)host_lcd_ram;
+    host_lcd_control = (host_lcd_control & ~LCD_CONTROL_BPP_MASK) | LCD_CONTROL_16BPP;
+}
+
+void gfx_SetDraw(uint8_t location)
+{
+    host_vbuffer = HOST_BUFFER(location == gfx_buffer ? !screen_buffer : screen_buffer);
+}
+
+void gfx_SwapDraw(void)
+{
+    screen_buffer = !screen_buffer;
+    host_lcd_upbase = (uintptr_t)HOST_BUFFER(screen_buffer);
+    host_vbuffer = HOST_BUFFER(!screen_buffer);
+}
+
+// Copies part of one buffer into the same place in the other.
+void gfx_BlitRectangle(gfx_location_t src, unsigned int x, uint8_t y, unsigned int width, unsigned int height)
+{
+    uint8_t (*from)[GFX_LCD_WIDTH] = HOST_BUFFER(src == gfx_screen ? screen_buffer : !screen_buffer);
+    uint8_t (*to)[GFX_LCD_WIDTH] = HOST_BUFFER(src == gfx_screen ? !screen_buffer : screen_buffer);
+
+    for (unsigned int row = y; row < y + height; row++)
+        memcpy(&to[row][x], &from[row][x], width);
+}
+
+uint8_t gfx_SetColor(uint8_t index)
+{
+    uint8_t previous = color_index;
+    color_index = index;
+    return previous;
+}
+
+void gfx_FillScreen(uint8_t index)
+{
+    memset(host_vbuffer, index, GFX_LCD_WIDTH * GFX_LCD_HEIGHT);
+}
+
+void gfx_FillRectangle(int x, int y, int width, int height)
+{
+    int left = (x < 0) ? 0 : x;
+    int top = (y < 0) ? 0 : y;
+    int right = (x + width > GFX_LCD_WIDTH) ? GFX_LCD_WIDTH : x + width;
+    int bottom = (y + height > GFX_LCD_HEIGHT) ? GFX_LCD_HEIGHT : y + height;
+
+    for (int row = top; row < bottom; row++) {
+        if (right > left)
+            memset(&host_vbuffer[row][left], color_index, right - left);
+    }
+}
+
+void gfx_FillRectangle_NoClip(unsigned int x, uint8_t y, unsigned int width, uint8_t height)
+{
+    // On the calculator this would scribble over whatever's next in memory.
+    if (x + width > GFX_LCD_WIDTH || (unsigned int)y + height > GFX_LCD_HEIGHT) {
+        fprintf(stderr, "gfx_FillRectangle_NoClip(%u, %u, %u, %u) is off screen.\n", x, y, width, height);
+        exit(2);
+    }
+
+    gfx_FillRectangle((int)x, y, (int)width, height);
+}
+
+void gfx_PrintStringXY(const char* string, int x, int y)
+{
+    (void)x;
+    (void)y;
+
+    if (host_verbose)
+        fprintf(stderr, "%s\n", string);
+}
+
+void host_capture_canvas(uint8_t* canvas)
+{
+    const uint8_t* screen = (const uint8_t*)host_lcd_upbase;
+
+    for (int y = 0; y < 240; y++) {
+        for (int x = 0; x < 240; x++) {
+            int lcd_x = x + 40;
+
+            if ((host_lcd_control & LCD_CONTROL_BPP_MASK) == 0) {
+                // 1bpp, the leftmost pixel in the lowest bit.
+                int bit = (screen[y * (GFX_LCD_WIDTH / 8) + lcd_x / 8] >> (lcd_x & 7)) & 1;
+                canvas[y * 240 + x] = (host_lcd_palette[bit] == 0) ? 0 : 255;
+            } else {
+                canvas[y * 240 + x] = screen[y * GFX_LCD_WIDTH + lcd_x];
+            }
+        }
+    }
+}
+
+// ----------------------------
+// Timers
+// ----------------------------
+
+static bool timer_enabled = false;
+static uint32_t timer_value = 0;
+static uint64_t timer_cycles = 0;   // host_cycles when timer_value was last right.
+
+static uint32_t timer_ticks(void)
+{
+    if (!timer_enabled)
+        return timer_value;
+
+    return timer_value + (uint32_t)((host_cycles - timer_cycles) * 32768 / HOST_CLOCK_HZ);
+}
+
+void host_timer_enable(int timer)
+{
+    (void)timer;
+    timer_cycles = host_cycles;
+    timer_enabled = true;
+}
+
+void host_timer_disable(int timer)
+{
+    (void)timer;
+    timer_value = timer_ticks();
+    timer_enabled = false;
+}
+
+void host_timer_set(int timer, uint32_t value)
+{
+    (void)timer;
+    timer_value = value;
+    timer_cycles = host_cycles;
+}
+
+uint32_t host_timer_get(int timer)
+{
+    (void)timer;
+    host_cycles += HOST_CYCLES_PER_POLL;
+    host_idle_cycles += HOST_CYCLES_PER_POLL;
+    return timer_ticks();
+}
+
+// ----------------------------
+// Compression
+// ----------------------------
+
+// ZX7, the way the reference decompressor reads it: control bits come a byte at a
+// time from the top, in between the literal and offset bytes.
+typedef struct {
+    const uint8_t* data;
+    uint8_t bits;
+    uint8_t mask;
+} zx7_reader_t;
+
+static int zx7_read_bit(zx7_reader_t* reader)
+{
+    if (reader->mask == 0) {
+        reader->mask = 128;
+        reader->bits = *reader->data++;
+    }
+
+    int bit = (reader->bits & reader->mask) != 0;
+    reader->mask >>= 1;
+    return bit;
+}
+
+static int zx7_read_elias_gamma(zx7_reader_t* reader)
+{
+    int bits = 0;
+    while (!zx7_read_bit(reader))
+        bits++;
+
+    // Anything this long is the end marker.
+    if (bits > 15)
+        return -1;
+
+    int value = 1;
+    while (bits-- > 0)
+        value = (value << 1) | zx7_read_bit(reader);
+
+    return value;
+}
+
+void zx7_Decompress(void* destination, const void* source)
+{
+    zx7_reader_t reader = { source, 0, 0 };
+    uint8_t* output = destination;
+    uint8_t* start = output;
+
+    *output++ = *reader.data++;
+
+    while (true) {
+        if (!zx7_read_bit(&reader)) {
+            *output++ = *reader.data++;
+            continue;
+        }
+
+        int length = zx7_read_elias_gamma(&reader) + 1;
+        if (length == 0)
+            break;
+
+        int offset = *reader.data++;
+        if (offset >= 128) {
+            int high = 0;
+            for (int i = 0; i < 4; i++)
+                high = (high << 1) | zx7_read_bit(&reader);
+            offset = ((offset & 127) | (high << 7)) + 128;
+        }
+        offset++;
+
+        while (length-- > 0) {
+            *output = *(output - offset);
+            output++;
+        }
+    }
+
+    host_cycles += (uint64_t)(output - start) * HOST_CYCLES_PER_UNPACKED_BYTE;
+}
+
+// ----------------------------
+// Keypad
+// ----------------------------
+
+uint8_t os_GetCSC(void)
+{
+    return 9; // sk_Enter
+}
+
+volatile uint16_t host_kb_data[8];
+
+void kb_SetMode(kb_scan_mode_t mode)
+{
+    (void)mode;
+}
+
+void kb_Reset(void)
+{
+}
+
+// ----------------------------
+// fileioc
+// ----------------------------
+
+// There's no AppVar to read, the benchmark always plays a compiled-in style video.
+char* ti_Detect(void** search_position, const char* detection_string)
+{
+    (void)search_position;
+    (void)detection_string;
+    return NULL;
+}
+
+uint8_t ti_Open(const char* name, const char* mode)
+{
+    (void)name;
+    return (mode[0] == 'w') ? 1 : 0;
+}
+
+int ti_Close(uint8_t handle)
+{
+    (void)handle;
+    return 1;
+}
+
+size_t ti_Write(const void* data, size_t size, size_t count, uint8_t handle)
+{
+    (void)handle;
+
+    unsigned char* grown = realloc(host_appvar_data, host_appvar_size + size * count);
+    if (grown == NULL)
+        return 0;
+
+    memcpy(grown + host_appvar_size, data, size * count);
+    host_appvar_data = grown;
+    host_appvar_size += size * count;
+    return count;
+}
+
+void* ti_GetDataPtr(uint8_t handle)
+{
+    (void)handle;
+    return NULL;
+}
+
+uint16_t ti_GetSize(uint8_t handle)
+{
+    (void)handle;
+    return 0;
+}
@@ -0,0 +1,39 @@
+// The host side of the stubbed CE libraries in include/, shared by host.c and the
+// benchmark in bench.c. Time on the host is modeled: the timers count eZ80 cycles
+// the benchmark charges for, not real time.
+#ifndef _VID84_HOST_H_
+#define _VID84_HOST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The eZ80 in the CE runs at 48MHz.
+#ifndef HOST_CLOCK_HZ
+#define HOST_CLOCK_HZ               48000000
+#endif
+// Reading a timer, and the loop around it when waiting on one.
+#ifndef HOST_CYCLES_PER_POLL
+#define HOST_CYCLES_PER_POLL        60
+#endif
+// zx7_Decompress, per byte it puts out.
+#ifndef HOST_CYCLES_PER_UNPACKED_BYTE
+#define HOST_CYCLES_PER_UNPACKED_BYTE 25
+#endif
+
+extern uint64_t host_cycles;        // Everything so far.
+extern uint64_t host_idle_cycles;   // The part of it spent reading timers.
+
+// What the player saved with ti_Write, if anything.
+extern unsigned char* host_appvar_data;
+extern size_t host_appvar_size;
+
+extern bool host_verbose;           // Print what the player puts on screen to stderr.
+
+// Copies the 240x240 canvas currently on screen out as bytes, 0 for black and 255 for white.
+void host_capture_canvas(uint8_t* canvas);
+
+// False if playback left the LCD in 1bpp mode.
+bool host_lcd_restored(void);
+
+#endif // _VID84_HOST_H_
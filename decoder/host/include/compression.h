@@ -0,0 +1,7 @@
+// Host stand-in for the toolchain's decompressors.
+#ifndef _VID84_HOST_COMPRESSION_H_
+#define _VID84_HOST_COMPRESSION_H_
+
+void zx7_Decompress(void* destination, const void* source);
+
+#endif // _VID84_HOST_COMPRESSION_H_
@@ -0,0 +1,17 @@
+// Host stand-in for fileioc. There are no AppVars to read, but writes (the
+// telemetry AppVar) are kept so the benchmark can save them.
+#ifndef _VID84_HOST_FILEIOC_H_
+#define _VID84_HOST_FILEIOC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+char* ti_Detect(void** search_position, const char* detection_string);
+uint8_t ti_Open(const char* name, const char* mode);
+int ti_Close(uint8_t handle);
+size_t ti_Write(const void* data, size_t size, size_t count, uint8_t handle);
+void* ti_GetDataPtr(uint8_t handle);
+uint16_t ti_GetSize(uint8_t handle);
+
+#endif // _VID84_HOST_FILEIOC_H_
@@ -0,0 +1,34 @@
+// Host stand-in for the graphx calls the player makes. Everything draws into
+// plain memory buffers, see host.c.
+#ifndef _VID84_HOST_GRAPHX_H_
+#define _VID84_HOST_GRAPHX_H_
+
+#include <stdint.h>
+
+#define GFX_LCD_WIDTH               320
+#define GFX_LCD_HEIGHT              240
+
+typedef enum {
+    gfx_screen = 0,
+    gfx_buffer = 1,
+} gfx_location_t;
+
+void gfx_Begin(void);
+void gfx_End(void);
+void gfx_SetDraw(uint8_t location);
+void gfx_SwapDraw(void);
+uint8_t gfx_SetColor(uint8_t index);
+void gfx_FillScreen(uint8_t index);
+void gfx_FillRectangle(int x, int y, int width, int height);
+void gfx_FillRectangle_NoClip(unsigned int x, uint8_t y, unsigned int width, uint8_t height);
+void gfx_PrintStringXY(const char* string, int x, int y);
+void gfx_BlitRectangle(gfx_location_t src, unsigned int x, uint8_t y, unsigned int width, unsigned int height);
+
+#define gfx_SetDrawBuffer()         gfx_SetDraw(gfx_buffer)
+#define gfx_SetDrawScreen()         gfx_SetDraw(gfx_screen)
+
+// The buffer being drawn to, like the real gfx_vbuffer.
+extern uint8_t (*host_vbuffer)[GFX_LCD_WIDTH];
+#define gfx_vbuffer                 host_vbuffer
+
+#endif // _VID84_HOST_GRAPHX_H_
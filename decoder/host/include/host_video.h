@@ -0,0 +1,8 @@
+// The video the benchmark loaded from disk, in place of a compiled-in header.
+#ifndef _VID84_H_
+#define _VID84_H_
+
+extern unsigned char* video_bin;
+extern unsigned int video_bin_len;
+
+#endif // _VID84_H_
@@ -0,0 +1,32 @@
+// Host stand-in for keypadc. Nothing is ever held down, so playback controls
+// never do anything.
+#ifndef _VID84_HOST_KEYPADC_H_
+#define _VID84_HOST_KEYPADC_H_
+
+#include <stdint.h>
+
+typedef enum {
+    MODE_0_IDLE = 0,
+    MODE_1_INDISCRIMINATE,
+    MODE_2_SINGLE,
+    MODE_3_CONTINUOUS
+} kb_scan_mode_t;
+
+// Group 1.
+#define kb_2nd                      (1 << 5)
+// Group 6.
+#define kb_Enter                    (1 << 0)
+#define kb_Clear                    (1 << 6)
+// Group 7.
+#define kb_Down                     (1 << 0)
+#define kb_Left                     (1 << 1)
+#define kb_Right                    (1 << 2)
+#define kb_Up                       (1 << 3)
+
+extern volatile uint16_t host_kb_data[8];
+#define kb_Data                     host_kb_data
+
+void kb_SetMode(kb_scan_mode_t mode);
+void kb_Reset(void);
+
+#endif // _VID84_HOST_KEYPADC_H_
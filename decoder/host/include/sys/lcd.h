@@ -0,0 +1,20 @@
+// Host stand-in for the LCD controller registers and VRAM.
+#ifndef _VID84_HOST_LCD_H_
+#define _VID84_HOST_LCD_H_
+
+#include <stdint.h>
+
+extern uint8_t host_lcd_ram[320 * 240 * 2];
+extern uintptr_t host_lcd_upbase;
+extern uint32_t host_lcd_control;
+extern uint16_t host_lcd_palette[256];
+extern uint8_t host_lcd_int_acknowledge;
+
+#define lcd_Ram                     ((uint16_t*)host_lcd_ram)
+#define lcd_UpBase                  host_lcd_upbase
+#define lcd_Control                 host_lcd_control
+#define lcd_Palette                 host_lcd_palette
+#define lcd_IntStatus               0x04    // The new base address is always picked up right away.
+#define lcd_IntAcknowledge          host_lcd_int_acknowledge
+
+#endif // _VID84_HOST_LCD_H_
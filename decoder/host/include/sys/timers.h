@@ -0,0 +1,25 @@
+// Host stand-in for the hardware timers. They count modeled eZ80 time rather
+// than real time, see host.c.
+#ifndef _VID84_HOST_TIMERS_H_
+#define _VID84_HOST_TIMERS_H_
+
+#include <stdint.h>
+
+#define TIMER_32K                   1
+#define TIMER_CPU                   0
+#define TIMER_NOINT                 0
+#define TIMER_0INT                  1
+#define TIMER_UP                    1
+#define TIMER_DOWN                  0
+
+void host_timer_enable(int timer);
+void host_timer_disable(int timer);
+void host_timer_set(int timer, uint32_t value);
+uint32_t host_timer_get(int timer);
+
+#define timer_Enable(n, rate, interrupt, direction) host_timer_enable(n)
+#define timer_Disable(n)            host_timer_disable(n)
+#define timer_Set(n, value)         host_timer_set(n, value)
+#define timer_Get(n)                host_timer_get(n)
+
+#endif // _VID84_HOST_TIMERS_H_
@@ -0,0 +1,9 @@
+// Host stand-in for os_GetCSC, every prompt gets a key straight away.
+#ifndef _VID84_HOST_GETCSC_H_
+#define _VID84_HOST_GETCSC_H_
+
+#include <stdint.h>
+
+uint8_t os_GetCSC(void);
+
+#endif // _VID84_HOST_GETCSC_H_
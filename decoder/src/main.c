@@ -1,13 +1,14 @@
 /*
-84VID/VID84 Video Decoder and Player - v1.0
+84VID/VID84 Video Decoder and Player - v2.0
 
 The Encoder, Decoder, and Spec are in the Public Domain.
 No warranty implied; use at your own risk.
 
 Features:
 - 240x240 Resolution Canvas with Integer Down-Scaling.
-- Supporting Custom FPS/Refresh Rates up to 63Hz (soft limit).
+- Supporting Custom FPS/Refresh Rates up to 63Hz (soft limit), or 126 fields a second interlaced.
 - Black-On-White (No color, no grayscale).
+- Delta frames that only repaint what changed (version 2).
 
 Video File Specification:
 
@@ -18,9 +19,9 @@ typedef struct {
     unsigned char scale_factor; // The Integer Down-scale factor (ex. 2 for 120x120).
 } vid84header_t;
 
-84VID/VID84 (interchangeable) does not contain any features to
-optimize frames by detecting duplicate data. As such, it was
-important to keep data storage tiny, and simple.
+84VID/VID84 (interchangeable) keeps data storage tiny, and simple. Version 1 stores
+every frame whole, with nothing to pick up on what it shares with the one before;
+version 2 (below) adds delta, repeat and tile frames for that.
 
 Frames always begin with 0xFF. The bytes in between frames will always be divisible
 by four, this is because the "image" data is actually a sequence of rectangles.
@@ -46,293 +47,2388 @@ There are no start and end indicators for the rectangles. The decoder and player
 to keep track interally of the values.
 
 The video will always end with 0xFE.
+
+Version 2:
+
+Version 1 re-sends and re-draws the entire frame every time, even though consecutive
+frames are usually almost identical. Version 2 adds delta frames for this, and
+a flags byte to the header which comes right after scale_factor:
+
+    unsigned char flags;        // Optional feature bits, see below. Unknown bits are rejected.
+
+Frames still begin with 0xFF, but the byte after it is now the frame type:
+
+    0x00 - Keyframe. The canvas is cleared and every rectangle after is painted black,
+           same as a version 1 frame.
+    0x01 - Delta frame. The canvas is left as the previous frame drew it. Rectangles
+           are painted black up until a 0xFD marker, and every rectangle after it is
+           painted white.
+    0x02 - Span frame. The canvas is cleared like a keyframe, but the frame is stored
+           as runs of black pixels on each row instead of rectangles. Only allowed
+           when the span frames flag is set, see below.
+    0x03 - Repeat. Just one more byte, a count from 1 to 255: the frame on screen is
+           held for that many frame times, with nothing to draw. Static shots and
+           title cards come out as a few bytes for every 255 frames.
+    0x04 - Tile frame. The canvas is split into 16x16 tiles (before scaling, the last
+           row and column get cut short when 16 doesn't go into it). The frame starts
+           with a bit for each tile, set for the ones that changed. Those are cleared,
+           and every rectangle after is painted black, all of them inside the changed
+           tiles. Only allowed when the tile frames flag is set, see below.
+
+The first frame is always a keyframe, and the encoder forces more of them in at a
+regular interval so there are places to start decoding from besides the beginning.
+
+Since deltas build on top of each other, version 2 rectangles are exact: x2 and y2
+are inclusive, so a rectangle is (x2 - x + 1) by (y2 - y + 1) pixels before scaling.
+Version 1 rectangles are drawn one pixel short on both axes, which deltas can't afford.
+
+Flags:
+
+    0x01 - Frame index. The 0xFE end code is followed by a table of where every frame's
+           0xFF is, so the player can jump straight to any frame. It goes by frame
+           times, so a repeat frame gets an entry for each one it covers:
+
+    typedef struct {
+        uint24_t offsets[frame_count]; // File offset of each frame's 0xFF, little endian.
+        uint24_t frame_count;          // Always the last three bytes of the file.
+    } vid84index_t;
+
+    0x02 - Rectangle sizes. Rectangles store their size instead of their far corner,
+           so the decoder doesn't have to work it out for every one of them:
+
+    typedef struct {
+        unsigned char x;            // Left X Coordinate.
+        unsigned char y;            // Top Y Coordinate.
+        unsigned char width;        // Width, always 1 or more.
+        unsigned char height;       // Height, always 1 or more.
+    } vid84rectsize_t;
+
+    0x04 - Span frames. The video may have frames of type 0x02. Noisy or dithered frames
+           mesh into piles of tiny rectangles, and a row of runs is much smaller than
+           those. Only rows with anything on them are stored:
+
+    typedef struct {
+        unsigned char y;            // Row.
+        unsigned char count;        // Number of runs that follow, always 1 or more.
+        struct {
+            unsigned char x;        // Left X Coordinate.
+            unsigned char length;   // Length of the run minus one.
+        } runs[count];
+    } vid84spanrow_t;
+
+    Markers only show up where a row would start.
+
+    0x08 - Compressed. Everything after the header is split into blocks of whole frames,
+           each compressed with ZX7 on its own, so the player can decompress them into
+           RAM one at a time as it plays. Decompressed, a block ends with 0xFC to carry
+           on into the next, or the 0xFE end code for the last. Never used together with
+           the frame index.
+
+    typedef struct {
+        uint16_t size;              // Size decompressed, little endian.
+        uint16_t packed_size;       // Size of the data that follows.
+        unsigned char data[packed_size];
+    } vid84block_t;
+
+    0x10 - Packed rectangles. Each rectangle is stored relative to the one before it, so
+           the common ones fit in two or three bytes instead of four. Overrides the
+           rectangle sizes flag. The first byte says how the rest is stored:
+
+    0x00-0x3F - Same row as the last one, (code) pixels past its right edge. Then one
+                byte of (width - 1) << 4 | (height - 1).
+    0x40-0x7F - (code - 0x3F) rows further down. Then x, and the size as above.
+    0x80-0xBF - Same row as the last one, (code - 0x80) pixels past its right edge.
+                Then width - 1 and height - 1.
+    0xC0-0xFA - (code - 0xC0) rows further down. Then x, width - 1 and height - 1.
+    0xFB      - Anywhere. Then x, y, width - 1 and height - 1.
+
+    The last rectangle starts out zero sized at 0, 0 at the start of every frame, and
+    again after a 0xFD. Only first bytes are kept clear of markers, the rest can be
+    anything, so a video has to be walked a rectangle at a time to find its frames.
+
+    0x20 - Tile frames. The video may have frames of type 0x04. They suit changes that
+           are a mess of small rectangles as a delta, but simple inside the tiles they
+           touch. The tile bitmask comes right after the frame type:
+
+    typedef struct {
+        // Bit (i & 7) of byte (i >> 3) is tile i, going left to right, top to bottom.
+        unsigned char tiles[(tiles_across * tiles_across + 7) / 8];
+    } vid84tilemask_t;
+
+    0x40 - Interlaced. After the first frame, frames can be fields: just the even or the
+           odd rows of the video, drawn over what's on screen and leaving the other rows
+           be. The frame rate counts fields, so twice what it would be for whole frames
+           goes, up to 126. A field sets the top bits of its frame type:
+
+    0x80 - Field. Rectangles and spans are laid out in a video half as tall, row y of
+           it being row 2y of the video (2y + 1 for odd fields). A key or span field
+           only clears its own rows. Fields are never tile frames.
+    0x40 - Odd field, only with 0x80.
+
+    Repeats never have them, and only whole key and span frames can be started from.
+
+AppVars:
+
+A video too big for one AppVar is split into several, named NAME00, NAME01 and so on.
+Splits only happen where a frame starts, before the 0xFE end code, or between frame
+index entries, or between blocks of a compressed video. Every AppVar but the last ends
+with 0xFC, which just means "carry on in the next one"; it isn't part of the video, so
+offsets in the frame index don't count it.
 */
 
 #include <ti/getcsc.h>
 #include <sys/timers.h>
+#include <sys/lcd.h>
 #include <graphx.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
-#include <time.h>
-
-// Video file header. Only one can be included at a time.
+#include <stdint.h>
+
+// Player build options. Any of these can be overridden from the makefile's
+// CFLAGS, ex. -DVID84_DOUBLE_BUFFER=0.
+#ifndef VID84_DOUBLE_BUFFER
+#define VID84_DOUBLE_BUFFER         1   // Decode each frame into the back buffer and swap on its deadline.
+#endif
+#ifndef VID84_SOURCE_APPVAR
+#define VID84_SOURCE_APPVAR         0   // Play from archived AppVars instead of a header compiled in.
+#endif
+#ifndef VID84_FRAME_DROP
+#define VID84_FRAME_DROP            1   // Skip frames to catch back up when we fall more than a frame behind.
+#endif
+#ifndef VID84_FILL_BACKEND
+#define VID84_FILL_BACKEND          1   // How rectangles get filled in, one of FILL_BACKEND_* below.
+#endif
+#ifndef VID84_LCD_1BPP
+#define VID84_LCD_1BPP              0   // Put the LCD in 1bpp mode for playback, overrides the fill backend.
+#endif
+#ifndef VID84_TELEMETRY
+#define VID84_TELEMETRY             0   // Time every frame, show a summary after playback and save it to an AppVar.
+#endif
+#ifndef VID84_COMPRESSION
+#define VID84_COMPRESSION           1   // Play compressed videos, decompressing them into RAM as they go.
+#endif
+#ifndef VID84_PRERENDER
+#define VID84_PRERENDER             1   // In 1bpp mode, draw the heaviest keyframes into spare VRAM before playback.
+#endif
+#ifndef VID84_INTERLACE
+#define VID84_INTERLACE             1   // Play interlaced videos, drawing half the rows for each field.
+#endif
+#ifndef VID84_CONTROLS
+#define VID84_CONTROLS              1   // Pause, skip and quit keys during playback, read once a frame.
+#endif
+
+#if VID84_SOURCE_APPVAR || VID84_TELEMETRY
+#include <fileioc.h>
+#endif
+
+#if VID84_COMPRESSION
+#include <compression.h>
+#endif
+
+#if VID84_CONTROLS
+#include <keypadc.h>
+#endif
+
+#if !VID84_SOURCE_APPVAR
+// Video file header. Only one can be included at a time. VID84_VIDEO_HEADER picks
+// a different one from the makefile, ex. -DVID84_VIDEO_HEADER='"myvideo.h"'.
+#ifdef VID84_VIDEO_HEADER
+#include VID84_VIDEO_HEADER
+#else
 #include "sample.h"
-
-unsigned char video_fps;
+#endif
+#endif
+
+// Hooks for the host benchmark in decoder/host, they're nothing on the calculator.
+#ifndef VID84_FILL_HOOK
+#define VID84_FILL_HOOK(x, y, width, height)
+#endif
+// The frame hook gets called once per frame time, as soon as the frame is on screen.
+#ifndef VID84_FRAME_HOOK
+#define VID84_FRAME_HOOK(frame_number, cursor)
+#endif
+#ifndef VID84_COPY_HOOK
+#define VID84_COPY_HOOK(size)
+#endif
+#ifndef VID84_START_HOOK
+#define VID84_START_HOOK()
+#endif
+
+unsigned char video_fps;     // Fields per second, for an interlaced video.
 unsigned char video_version;
 unsigned char video_scale_factor;
+int video_data_start;   // Offset of the first frame's 0xFF.
+int video_data_end;     // Offset of the 0xFE end code.
+
+// Version 2 header flags.
+#define VIDEO_FLAG_FRAME_INDEX      0x01
+#define VIDEO_FLAG_RECT_SIZE        0x02
+#define VIDEO_FLAG_SPAN_FRAMES      0x04
+#define VIDEO_FLAG_COMPRESSED       0x08
+#define VIDEO_FLAG_PACKED_RECTS     0x10
+#define VIDEO_FLAG_TILE_FRAMES      0x20
+#define VIDEO_FLAG_INTERLACED       0x40
+
+// Features that can be built out of the player, and their videos refused.
+#if VID84_COMPRESSION
+#define VIDEO_BUILT_FLAG_COMPRESSED VIDEO_FLAG_COMPRESSED
+#else
+#define VIDEO_BUILT_FLAG_COMPRESSED 0
+#endif
+#if VID84_INTERLACE
+#define VIDEO_BUILT_FLAG_INTERLACED VIDEO_FLAG_INTERLACED
+#else
+#define VIDEO_BUILT_FLAG_INTERLACED 0
+#endif
+#define VIDEO_KNOWN_FLAGS           (VIDEO_FLAG_FRAME_INDEX | VIDEO_FLAG_RECT_SIZE | VIDEO_FLAG_SPAN_FRAMES | VIDEO_FLAG_PACKED_RECTS | VIDEO_FLAG_TILE_FRAMES | \
+                                     VIDEO_BUILT_FLAG_COMPRESSED | VIDEO_BUILT_FLAG_INTERLACED)
+
+// Stock refresh rate is 63.5Hz. Interlaced videos count fields, two to a frame.
+#define VIDEO_MAX_FPS               63
+#define VIDEO_MAX_FIELD_RATE        (2 * VIDEO_MAX_FPS)
+
+// How rectangles are laid out in the video.
+#define RECT_FORMAT_V1              0   // Corners, drawn one pixel short.
+#define RECT_FORMAT_CORNERS         1   // Inclusive corners.
+#define RECT_FORMAT_SIZE            2   // Corner and size.
+#define RECT_FORMAT_PACKED          3   // Relative to the last rectangle, two to five bytes.
+unsigned char video_rect_format;
+
+// Whether the header says to expect span frames.
+bool video_span_frames = false;
+
+// Packed rectangle codes, the first byte of each one says how the rest is stored.
+#define PACKED_RECT_SAME_ROW        0x00    // + gap, then the size in nibbles.
+#define PACKED_RECT_ROWS_DOWN       0x40    // + rows down - 1, then x and the size in nibbles.
+#define PACKED_RECT_SAME_ROW_LARGE  0x80    // + gap, then width - 1 and height - 1.
+#define PACKED_RECT_ROWS_DOWN_LARGE 0xC0    // + rows down, then x, width - 1 and height - 1.
+#define PACKED_RECT_ABSOLUTE        0xFB    // x, y, width - 1 and height - 1.
+#define PACKED_RECT_LENGTH(code)    ((code) < PACKED_RECT_ROWS_DOWN ? 2 : \
+                                     (code) < PACKED_RECT_ROWS_DOWN_LARGE ? 3 : \
+                                     (code) < PACKED_RECT_ABSOLUTE ? 4 : 5)
+
+// How many bytes the rectangle starting with code takes up.
+static inline int rectangle_length(unsigned char code)
+{
+    return (video_rect_format == RECT_FORMAT_PACKED) ? PACKED_RECT_LENGTH(code) : 4;
+}
+
+// Frame index, when the video has one.
+int video_frame_index = -1; // Offset of the first entry.
+int video_frame_count = 0;
+
+// Version 2 frame types, stored in the byte after each 0xFF.
+#define FRAME_TYPE_KEY              0x00
+#define FRAME_TYPE_DELTA            0x01
+#define FRAME_TYPE_SPANS            0x02
+#define FRAME_TYPE_REPEAT           0x03
+#define FRAME_TYPE_TILES            0x04
+
+// Top bits of an interlaced video's frame types, see the spec.
+#define FRAME_FIELD                 0x80
+#define FRAME_FIELD_ODD             0x40
+#define FRAME_TYPE_MASK             0x3F
+
+// Frames that don't need the one before them, and can be started from. Fields
+// don't pass as these, they leave half the rows to the frames before them.
+#define FRAME_STARTS_BLANK(type)    ((type) == FRAME_TYPE_KEY || (type) == FRAME_TYPE_SPANS)
+
+// Frames drawn on top of the one before them.
+#define FRAME_NEEDS_PREVIOUS(type)  ((type) == FRAME_TYPE_DELTA || (type) == FRAME_TYPE_TILES || ((type) & FRAME_FIELD))
+
+// Tile frames start with a bitmask of which tiles changed, this many pixels square.
+#define VIDEO_TILE_SIZE             16
+int video_tiles_across;     // Tiles across the canvas, and down it. The last ones can be cut short.
+int video_tile_mask_length; // Bytes in a tile frame's bitmask.
+
+// How many frame times the version 2 frame at cursor (its type byte) is on screen for.
+#define FRAME_PERIODS(cursor)       ((cursor)[0] == FRAME_TYPE_REPEAT ? (int)(cursor)[1] : 1)
+
+// Delta frame marker, every rectangle after it is painted white.
+#define DELTA_COLOR_SWITCH          0xFD
+
+// Ends every AppVar of a video but the last, the video carries on in the next one.
+// It isn't part of the video itself, so it doesn't count towards any offsets.
+#define VIDEO_CHUNK_END             0xFC
+
+#define VIDEO_MAX_CHUNKS            100 // AppVars are named XXXXXX00 through XXXXXX99.
+
+// Where each piece of the video lives. Data is read in place, so when it comes from
+// archived AppVars these point straight into flash.
+const unsigned char* video_chunk_data[VIDEO_MAX_CHUNKS];
+int video_chunk_start[VIDEO_MAX_CHUNKS];    // Offset into the video the chunk starts at.
+int video_chunk_length[VIDEO_MAX_CHUNKS];   // Not counting its VIDEO_CHUNK_END.
+int video_chunk_count = 0;
+int video_length = 0;
+
+// Compressed videos are read out of RAM instead, see below.
+bool video_compressed = false;
+
+void add_video_chunk(const unsigned char* data, int size)
+{
+    video_chunk_data[video_chunk_count] = data;
+    video_chunk_start[video_chunk_count] = video_length;
+    video_chunk_length[video_chunk_count] = size;
+
+    video_length += size;
+    video_chunk_count++;
+}
+
+bool open_video_source(void)
+{
+#if VID84_SOURCE_APPVAR
+    // The first AppVar is the only one that starts with the identifier.
+    void* search_pos = NULL;
+    char* found_name = ti_Detect(&search_pos, "84VID");
+    if (found_name == NULL)
+        return false;
+
+    char name[9];
+    strncpy(name, found_name, 8);
+    name[8] = '\0';
+
+    int name_length = (int)strlen(name);
+    bool numbered = name_length >= 2 && name[name_length - 2] == '0' && name[name_length - 1] == '0';
+
+    for (int i = 0; i < VIDEO_MAX_CHUNKS; i++) {
+        if (i > 0) {
+            // Anything not ending in 00 is a whole video in one AppVar.
+            if (!numbered)
+                break;
+
+            name[name_length - 2] = (char)('0' + i / 10);
+            name[name_length - 1] = (char)('0' + i % 10);
+        }
+
+        uint8_t handle = ti_Open(name, "r");
+        if (handle == 0)
+            break;
+
+        const unsigned char* data = ti_GetDataPtr(handle);
+        int size = (int)ti_GetSize(handle);
+        ti_Close(handle);
+
+        if (size == 0)
+            return false;
+
+        // The one before this wasn't the last, so the marker at its end isn't data.
+        if (video_chunk_count > 0) {
+            int last = video_chunk_count - 1;
+            if (video_chunk_data[last][video_chunk_length[last] - 1] != VIDEO_CHUNK_END)
+                return false;
+
+            video_chunk_length[last]--;
+            video_length--;
+        }
+
+        add_video_chunk(data, size);
+    }
+#else
+    add_video_chunk(video_bin, (int)video_bin_len);
+#endif
+
+    return video_chunk_count > 0;
+}
+
+const unsigned char* video_pointer(int offset)
+{
+    // Most look-ups are in order, so start with the last chunk that we found.
+    static int last_chunk = 0;
+
+    if (offset < video_chunk_start[last_chunk] ||
+    offset >= video_chunk_start[last_chunk] + video_chunk_length[last_chunk]) {
+        last_chunk = 0;
+        while (last_chunk < video_chunk_count - 1 &&
+        offset >= video_chunk_start[last_chunk] + video_chunk_length[last_chunk])
+            last_chunk++;
+    }
+
+    return video_chunk_data[last_chunk] + (offset - video_chunk_start[last_chunk]);
+}
+
+unsigned char video_byte(int offset)
+{
+    return *video_pointer(offset);
+}
+
+int read_uint16(const unsigned char* data)
+{
+    return (int)((unsigned int)data[0] | ((unsigned int)data[1] << 8));
+}
+
+#if VID84_COMPRESSION
+// Compressed videos get decompressed a block at a time into a ring of buffers. Along
+// with the block being read, the one before it has to stick around since the frame on
+// screen might have started in it, which leaves one to decompress the next block into
+// ahead of time. Double buffered builds redraw the shown frame into the back buffer,
+// so that only holds because a repeat catches the back buffer up and lets go of the
+// shown frame's block; otherwise a block of nothing but repeats would leave it two back.
+#define VIDEO_BLOCK_BUFFERS         3
+
+int video_block_count = 0;
+int video_block_size = 0;           // The most any block decompresses to, each buffer is this big.
+int video_blocks_unpacked = 0;
+int video_block_floor = 0;          // Oldest block anything is still reading from.
+int video_next_packed_block;        // Offset of the next block to decompress.
+int video_unpacked_length = 0;
+
+unsigned char* video_block_buffers[VIDEO_BLOCK_BUFFERS];
+int video_block_number[VIDEO_BLOCK_BUFFERS];   // Which block is in each buffer.
+int video_block_start[VIDEO_BLOCK_BUFFERS];    // Offset into the decompressed video it starts at.
+int video_block_length[VIDEO_BLOCK_BUFFERS];   // Not counting its VIDEO_CHUNK_END.
+
+// What looking further ahead than the ring holds runs into.
+const unsigned char video_lookahead_end = 0xFE;
+
+void unpack_video_block(void)
+{
+    const unsigned char* header = video_pointer(video_next_packed_block);
+    int slot = video_blocks_unpacked % VIDEO_BLOCK_BUFFERS;
+    unsigned char* buffer = video_block_buffers[slot];
+    int size = read_uint16(header);
+
+    zx7_Decompress(buffer, header + 4);
+
+    // Every block is whole frames, and they all carry on into the next but the last.
+    bool last = (video_blocks_unpacked == video_block_count - 1);
+    if (buffer[0] != 0xFF || buffer[size - 1] != (last ? 0xFE : VIDEO_CHUNK_END))
+        buffer[0] = 0xFE; // Bad data, end it here rather than draw garbage.
+
+    video_block_number[slot] = video_blocks_unpacked;
+    video_block_start[slot] = video_unpacked_length;
+    video_block_length[slot] = last ? size : size - 1;
+
+    video_unpacked_length += video_block_length[slot];
+    video_next_packed_block += 4 + read_uint16(header + 2);
+    video_blocks_unpacked++;
+}
+
+bool retrieve_video_blocks(void)
+{
+    // Each block starts with its sizes, and they have to add up to the rest of the
+    // video exactly. The encoder only ever splits AppVars between blocks.
+    int offset = video_data_start;
+    while (offset < video_length) {
+        if (video_length - offset < 5)
+            return false;
+
+        const unsigned char* header = video_pointer(offset);
+        int size = read_uint16(header);
+        int packed_size = read_uint16(header + 2);
+
+        if (size < 2 || packed_size == 0 || offset + 4 + packed_size > video_length)
+            return false;
+        if (video_pointer(offset + 3 + packed_size) != header + 3 + packed_size)
+            return false;
+
+        if (size > video_block_size)
+            video_block_size = size;
+
+        offset += 4 + packed_size;
+        video_block_count++;
+    }
+
+    if (video_block_count == 0)
+        return false;
+
+    video_block_buffers[0] = malloc(video_block_size * VIDEO_BLOCK_BUFFERS);
+    if (video_block_buffers[0] == NULL)
+        return false;
+
+    for (int i = 1; i < VIDEO_BLOCK_BUFFERS; i++)
+        video_block_buffers[i] = video_block_buffers[0] + i * video_block_size;
+
+    // Playback needs the first block, and the second shouldn't hold up the first frame.
+    video_next_packed_block = video_data_start;
+    while (video_blocks_unpacked < video_block_count && video_blocks_unpacked < VIDEO_BLOCK_BUFFERS - 1)
+        unpack_video_block();
+
+    return true;
+}
+
+// Which buffer data points into, it's always one of them.
+int video_block_slot(const unsigned char* data)
+{
+    for (int i = 1; i < VIDEO_BLOCK_BUFFERS; i++) {
+        if (data < video_block_buffers[i])
+            return i - 1;
+    }
+
+    return VIDEO_BLOCK_BUFFERS - 1;
+}
+
+// Lets the ring reuse every block before the one oldest points into.
+void release_video_blocks(const unsigned char* oldest)
+{
+    if (video_compressed)
+        video_block_floor = video_block_number[video_block_slot(oldest)];
+}
+
+const unsigned char* next_video_block(const unsigned char* block_end)
+{
+    int next = video_block_number[video_block_slot(block_end)] + 1;
+
+    if (next >= video_blocks_unpacked) {
+        if (next >= video_block_count || next > video_block_floor + VIDEO_BLOCK_BUFFERS - 1)
+            return &video_lookahead_end;
+
+        // Didn't get to it during the off-time, so it has to happen now.
+        unpack_video_block();
+    }
+
+    return video_block_buffers[next % VIDEO_BLOCK_BUFFERS];
+}
+#endif
+
+// Where a pointer into the video is, counting from the start of the first chunk.
+// Compressed videos count from the start of the decompressed data instead. Anything
+// that isn't in the video, like video_lookahead_end, is 0.
+int video_offset(const unsigned char* data)
+{
+#if VID84_COMPRESSION
+    if (video_compressed) {
+        if (data < video_block_buffers[0] || data > video_block_buffers[0] + video_block_size * VIDEO_BLOCK_BUFFERS)
+            return 0;
+
+        int slot = video_block_slot(data);
+        return video_block_start[slot] + (int)(data - video_block_buffers[slot]);
+    }
+#endif
+
+    for (int i = 0; i < video_chunk_count; i++) {
+        if (data >= video_chunk_data[i] && data <= video_chunk_data[i] + video_chunk_length[i])
+            return video_chunk_start[i] + (int)(data - video_chunk_data[i]);
+    }
+
+    return 0;
+}
+
+const unsigned char* next_video_chunk(const unsigned char* chunk_end)
+{
+#if VID84_COMPRESSION
+    if (video_compressed)
+        return next_video_block(chunk_end);
+#endif
+
+    // Frames never cross chunks, so this is only ever hit between two frames.
+    for (int i = 0; i < video_chunk_count - 1; i++) {
+        if (chunk_end == video_chunk_data[i] + video_chunk_length[i])
+            return video_chunk_data[i + 1];
+    }
+
+    return chunk_end;
+}
+
+int read_uint24(const unsigned char* data)
+{
+    return (int)((unsigned int)data[0] | ((unsigned int)data[1] << 8) | ((unsigned int)data[2] << 16));
+}
+
+int video_frame_offset(int frame)
+{
+    // Entries never get split between chunks.
+    return read_uint24(video_pointer(video_frame_index + frame * 3));
+}
+
+bool retrieve_frame_index(void)
+{
+    // The frame count is always at the very end, and the table sits right before it.
+    if (video_length < video_data_start + 7)
+        return false;
+
+    video_frame_count = read_uint24(video_pointer(video_length - 3));
+    if (video_frame_count == 0 || video_frame_count > (video_length - video_data_start) / 3)
+        return false;
+
+    video_data_end = video_length - 4 - video_frame_count * 3;
+    video_frame_index = video_data_end + 1;
+
+    // Every entry has to land on a frame start, in order. Frames are never shorter
+    // than their 0xFF and type byte, and only repeats get more than one entry.
+    int last_offset = video_data_start - 2;
+    for (int i = 0; i < video_frame_count; i++) {
+        int offset = video_frame_offset(i);
+
+        if (offset == last_offset && video_byte(offset + 1) == FRAME_TYPE_REPEAT)
+            continue;
+        if (offset < last_offset + 2 || offset >= video_data_end)
+            return false;
+        if (video_byte(offset) != 0xFF)
+            return false;
+
+        last_offset = offset;
+    }
+
+    // Starting anywhere but the first frame would skip the first keyframe.
+    if (video_frame_offset(0) != video_data_start)
+        return false;
+
+    return true;
+}
+
+const unsigned char* skip_frame(const unsigned char* cursor)
+{
+    bool spans = false;
+
+    // Step over the frame type, and a repeat's count or a tile frame's bitmask.
+    if ((int)video_version >= 2) {
+        spans = ((*cursor & FRAME_TYPE_MASK) == FRAME_TYPE_SPANS);
+        if (*cursor == FRAME_TYPE_REPEAT)
+            cursor++;
+        else if (*cursor == FRAME_TYPE_TILES)
+            cursor += video_tile_mask_length;
+        cursor++;
+    }
+
+    // Walks a rectangle or span row at a time, there's never a marker in the middle of one.
+    while (true) {
+        unsigned char data = *cursor;
+
+        if (data < VIDEO_CHUNK_END)
+            cursor += spans ? 2 + 2 * (int)cursor[1] : rectangle_length(data);
+        else if (data == DELTA_COLOR_SWITCH)
+            cursor++;
+        else if (data == VIDEO_CHUNK_END)
+            cursor = next_video_chunk(cursor);
+        else if (data == 0xFF)
+            return cursor + 1;
+        else
+            return cursor; // Leave the EoF be.
+    }
+}
+
+const unsigned char* seek_to_frame(int frame)
+{
+#if VID84_COMPRESSION
+    // Compressed videos only get read in order, from the start.
+    if (video_compressed)
+        return (frame == 0) ? video_block_buffers[0] : NULL;
+#endif
+
+    // Constant time, if the video came with an index.
+    if (video_frame_index != -1) {
+        if (frame >= video_frame_count)
+            return NULL;
+
+        return video_pointer(video_frame_offset(frame));
+    }
+
+    // Otherwise walk the frames the slow way. Packed rectangles can have 0xFF in
+    // them, so this has to step over whole rectangles instead of looking for it.
+    const unsigned char* cursor = video_pointer(video_data_start) + 1;
+    while (true) {
+        int periods = ((int)video_version >= 2) ? FRAME_PERIODS(cursor) : 1;
+        if (frame < periods)
+            return cursor - 1;
+
+        frame -= periods;
+        cursor = skip_frame(cursor);
+        if (*cursor == 0xFE)
+            return NULL;
+    }
+}
 
 bool retrieve_data_from_video(void)
 {
+    // Nothing we can read the whole header out of.
+    if (video_chunk_length[0] < 10)
+        return false;
+
+    const unsigned char* header = video_chunk_data[0];
+
     // Verify the magic, err, more like just the identifier but whatever. I was tired :s
-    if (video_bin[0] != '8' || video_bin[1] != '4' || video_bin[2] != 'V' ||
-    video_bin[3] != 'I' || video_bin[4] != 'D')
+    if (header[0] != '8' || header[1] != '4' || header[2] != 'V' ||
+    header[3] != 'I' || header[4] != 'D')
         return false;
 
-    // Verify the framerate isn't above stock (63.5Hz) and is not zero.
-    video_fps = video_bin[5];
-    if ((int)video_fps > 63 || (int)video_fps == 0)
+    // Verify the framerate is not zero, the most it can be depends on the flags.
+    video_fps = header[5];
+    if ((int)video_fps == 0)
         return false;
 
     // Version check
-    video_version = video_bin[6];
-    if ((int)video_version != 1)
+    video_version = header[6];
+    if ((int)video_version != 1 && (int)video_version != 2)
         return false;
 
     // Verify the scale factor
-    video_scale_factor = video_bin[7];
+    video_scale_factor = header[7];
     if ((int)video_scale_factor > 6 || (int)video_scale_factor == 0)
         return false;
 
-    // Lastly -- check last byte is 0xFE (end code!)
-    if (video_bin[video_bin_len - 1] != 0xFE)
+    video_tiles_across = (240 / (int)video_scale_factor + VIDEO_TILE_SIZE - 1) / VIDEO_TILE_SIZE;
+    video_tile_mask_length = (video_tiles_across * video_tiles_across + 7) / 8;
+
+    unsigned char flags = 0;
+
+    // Version 2 has a flags byte, refuse any we don't know about.
+    if ((int)video_version == 2) {
+        flags = header[8];
+        if ((flags & ~VIDEO_KNOWN_FLAGS) != 0)
+            return false;
+
+        video_span_frames = (flags & VIDEO_FLAG_SPAN_FRAMES) != 0;
+
+        if (flags & VIDEO_FLAG_PACKED_RECTS)
+            video_rect_format = RECT_FORMAT_PACKED;
+        else if (flags & VIDEO_FLAG_RECT_SIZE)
+            video_rect_format = RECT_FORMAT_SIZE;
+        else
+            video_rect_format = RECT_FORMAT_CORNERS;
+        video_data_start = 9;
+    } else {
+        video_rect_format = RECT_FORMAT_V1;
+        video_data_start = 8;
+    }
+
+    // Verify the framerate isn't above stock (63.5Hz), or twice that in fields.
+    if ((int)video_fps > ((flags & VIDEO_FLAG_INTERLACED) ? VIDEO_MAX_FIELD_RATE : VIDEO_MAX_FPS))
+        return false;
+
+    video_data_end = video_length - 1;
+    const unsigned char* first_frame = &header[video_data_start];
+
+#if VID84_COMPRESSION
+    if (flags & VIDEO_FLAG_COMPRESSED) {
+        // There's no jumping around in a compressed video, so no index either.
+        if (flags & VIDEO_FLAG_FRAME_INDEX)
+            return false;
+
+        video_compressed = true;
+        if (!retrieve_video_blocks())
+            return false;
+
+        first_frame = video_block_buffers[0];
+    }
+#endif
+
+    if (flags & VIDEO_FLAG_FRAME_INDEX) {
+        if (!retrieve_frame_index())
+            return false;
+    }
+
+    // There's nothing to build deltas on top of at the start.
+    if (first_frame[0] != 0xFF)
+        return false;
+    if ((int)video_version == 2 && !FRAME_STARTS_BLANK(first_frame[1]))
+        return false;
+    // Later frames get checked for it as they're read, see read_frame_type.
+    if (first_frame[1] == FRAME_TYPE_SPANS && !video_span_frames)
+        return false;
+
+    // Lastly -- check last byte is 0xFE (end code!) Compressed blocks get theirs checked
+    // as they're decompressed.
+    if (!video_compressed && video_byte(video_data_end) != 0xFE)
         return false;
     
     // LGTM!
     return true;
 }
 
+// A rectangle ready to fill, already scaled. Everything fits in a byte since the
+// canvas is 240x240, the 40px to center it on screen gets added at the last second.
 typedef struct {
-    int x;
-    int y;
-    int x2;
-    int y2;
+    uint8_t x;
+    uint8_t y;
+    uint8_t width;
+    uint8_t height;
 } vid84rect_t;
 
-#define RECTANGLE_QUEUE_COUNT       32  // This is the amount of rectangles we're allowed to pre-process.
+#define RECTANGLE_QUEUE_MIN         32  // Always there, even with no RAM to spare for a bigger one.
+
+// This is a process queue for downtime between frames. It's a ring of rectangles from
+// head up to tail, with a slot always left free so a full one isn't mistaken for empty.
+// It gets sized to fit the biggest frame in the video when there's RAM for it.
+vid84rect_t rect_queue_fallback[RECTANGLE_QUEUE_MIN];
+vid84rect_t* queued_rectangles = rect_queue_fallback;
+unsigned int rect_queue_size = RECTANGLE_QUEUE_MIN;
+unsigned int rect_queue_head = 0;   // Next one to draw.
+unsigned int rect_queue_tail = 0;   // Where the next one queued goes.
+
+// The frame type byte of the frame in the queue. Pre-processing has to step over
+// it, so it gets stashed here until the frame is drawn.
+#define NO_QUEUED_FRAME_TYPE        0xFF
+unsigned char queued_frame_type = NO_QUEUED_FRAME_TYPE;
+
+#if !VID84_DOUBLE_BUFFER
+// Bytes in the biggest frame of the video. It's a walk through the whole video without
+// an index, but that's only once, before playback.
+int largest_frame_length(void)
+{
+#if VID84_COMPRESSION
+    // Frames never span blocks.
+    if (video_compressed)
+        return video_block_size;
+#endif
+
+    int largest = 0;
+
+    if (video_frame_index != -1) {
+        int last_offset = video_frame_offset(0);
+
+        for (int i = 1; i <= video_frame_count; i++) {
+            int offset = (i < video_frame_count) ? video_frame_offset(i) : video_data_end;
+
+            if (offset - last_offset > largest)
+                largest = offset - last_offset;
+            last_offset = offset;
+        }
+
+        return largest;
+    }
+
+    const unsigned char* cursor = seek_to_frame(0) + 1;
+    int last_offset = video_offset(cursor);
+
+    do {
+        cursor = skip_frame(cursor);
+        int offset = video_offset(cursor);
+
+        if (offset - last_offset > largest)
+            largest = offset - last_offset;
+        last_offset = offset;
+    } while (*cursor != 0xFE);
 
-// This is a process queue for downtime between frames.
-vid84rect_t queued_rectangles[RECTANGLE_QUEUE_COUNT];
+    return largest;
+}
+#endif
 
 void init_render_queue(void)
 {
-    // Set the queue to -1 so we know there's no data in it.
-    for (int i = 0; i < RECTANGLE_QUEUE_COUNT; i++) {
-        queued_rectangles[i].x = -1;
-        queued_rectangles[i].y = -1;
-        queued_rectangles[i].x2 = -1;
-        queued_rectangles[i].y2 = -1;
+#if !VID84_DOUBLE_BUFFER
+    // Enough room for every rectangle of the biggest frame, at their smallest. When
+    // that doesn't fit in RAM, try for half as much until something does.
+    unsigned int wanted = largest_frame_length() / ((video_rect_format == RECT_FORMAT_PACKED) ? 2 : 4) + 1;
+
+    for (unsigned int size = wanted; size > RECTANGLE_QUEUE_MIN; size /= 2) {
+        vid84rect_t* queue = malloc(size * sizeof(vid84rect_t));
+
+        if (queue != NULL) {
+            queued_rectangles = queue;
+            rect_queue_size = size;
+            break;
+        }
     }
+#endif
+
+    rect_queue_head = 0;
+    rect_queue_tail = 0;
 }
 
-void process_next_frame(int* last_data_index, clock_t start_time, int time_per_frame_ms)
+// How many rectangles are waiting in the queue.
+unsigned int rect_queue_length(void)
 {
-    bool time_to_process = true;
-    unsigned char data;
-    int frame_time;
-    clock_t curr_time;
+    if (rect_queue_tail >= rect_queue_head)
+        return rect_queue_tail - rect_queue_head;
 
-    int rect_data_index = 0;
-    int rect_queue_index = 0;
+    return rect_queue_size - rect_queue_head + rect_queue_tail;
+}
 
-    bool queue_full = false;
-    bool end_of_frame = false;
+// Rectangle fill backends. Rectangles from the encoder always land inside the canvas,
+// so clipping every single one of them is wasted time. The clipped graphx fill is
+// still here for videos that might not play by those rules, and for comparison.
+#define FILL_BACKEND_GRAPHX         0   // gfx_FillRectangle, clipped.
+#define FILL_BACKEND_NOCLIP         1   // gfx_FillRectangle_NoClip.
+#define FILL_BACKEND_SPANS          2   // A memset per row, straight into the buffer being drawn to.
+
+uint8_t fill_color = 0;
+
+#if VID84_TELEMETRY
+// Every fill, rectangle or not, for the frame being drawn.
+unsigned int telemetry_fills = 0;
+#endif
+
+#if VID84_INTERLACE
+// While a field's being drawn, fills are in field rows. Each video row the field
+// has is canvas_field_rows (the scale factor) rows of the canvas, every other one
+// of them, starting canvas_field_start rows down. 0 rows for whole frames.
+uint8_t canvas_field_rows = 0;
+uint8_t canvas_field_start = 0;
+#endif
+
+static inline void set_fill_color(uint8_t color)
+{
+    fill_color = color;
+#if !VID84_LCD_1BPP
+    gfx_SetColor(color);
+#endif
+}
 
-    while(time_to_process) {
-        // Don't do anything if the queue is full.
-        if (queue_full == false && end_of_frame == false) {
-            // Grab some video data
-            data = video_bin[*last_data_index];
-
-            // Not EoF or new frame indicator
-            if (data != 0xFE && data != 0xFF) {
-
-                // Store the data
-                switch(rect_data_index) {
-                    case 0: queued_rectangles[rect_queue_index].x = (int)data * (int)video_scale_factor; break;
-                    case 1: queued_rectangles[rect_queue_index].y = (int)data * (int)video_scale_factor; break;
-                    case 2: queued_rectangles[rect_queue_index].x2 = (int)data * (int)video_scale_factor; break;
-                    case 3: queued_rectangles[rect_queue_index].y2 = (int)data * (int)video_scale_factor; break;
-                    default: break;
-                }
-
-                rect_data_index++;
-
-                // Move on to next rectangle
-                if (rect_data_index >= 4) {
-                    rect_data_index = 0;
-                    rect_queue_index++;
-
-                    if (rect_queue_index >= RECTANGLE_QUEUE_COUNT)
-                        queue_full = true;
-                }
-
-                // Iterate the data index.
-                (*last_data_index) += 1;
-            } else {
-                end_of_frame = true;
+#if VID84_LCD_1BPP
+// The video is only ever black and white, so in 1bpp mode each byte of the canvas
+// holds eight pixels, the leftmost one in the lowest bit. Palette entry 0 is black
+// and 1 is white, which makes the fill colors 0 and 255 also the bits to write.
+// A buffer is 9600 bytes instead of 76800, so fills touch an eighth of the memory.
+#define CANVAS_ROW_BYTES            (GFX_LCD_WIDTH / 8)
+#define CANVAS_BUFFER_SIZE          (CANVAS_ROW_BYTES * GFX_LCD_HEIGHT)
+
+// LCD control register bits, it's an ARM PL111 underneath.
+#define LCD_CONTROL_BPP_MASK        0x00E
+#define LCD_CONTROL_1BPP            0x000
+#define LCD_CONTROL_PIXEL_ORDER     0x600   // Big-endian byte and pixel ordering, both off.
+#define LCD_INT_LNBU                0x04    // The controller picked up the new base address.
+
+// Both buffers sit where the graphx back buffer was, so setting them up doesn't
+// mess with what's still on screen.
+uint8_t* canvas_buffers[2];
+uint8_t* canvas_draw_buffer;
+uint16_t saved_lcd_palette[2];
+uint32_t saved_lcd_control;
+
+#if VID84_PRERENDER
+// The rest of the back buffer's VRAM fits a few more canvases after those two. The
+// heaviest keyframes get drawn into them while the prompt is up, and copied in when
+// they come up instead of drawn again.
+#define PRERENDER_SLOTS             ((GFX_LCD_WIDTH * GFX_LCD_HEIGHT) / CANVAS_BUFFER_SIZE - 2)
+
+const unsigned char* prerendered_frame_start[PRERENDER_SLOTS];  // Just past its 0xFF, like draw_frame takes it.
+const unsigned char* prerendered_frame_end[PRERENDER_SLOTS];    // Where draw_frame left the cursor after it.
+int prerendered_frame_count = 0;
+
+static inline uint8_t* prerender_slot(int slot)
+{
+    return canvas_buffers[0] + (2 + slot) * CANVAS_BUFFER_SIZE;
+}
+
+// The slot a frame was drawn into ahead of time, if it was.
+int prerendered_frame(const unsigned char* cursor)
+{
+    for (int i = 0; i < prerendered_frame_count; i++) {
+        if (prerendered_frame_start[i] == cursor)
+            return i;
+    }
+
+    return -1;
+}
+#endif
+
+static void fill_canvas_rectangle(int x, int y, int width, int height)
+{
+    VID84_FILL_HOOK(x, y, width, height);
+
+#if VID84_TELEMETRY
+    telemetry_fills++;
+#endif
+
+#if VID84_INTERLACE
+    // Rows left before the field skips over the other's.
+    int band = height;
+    int band_left = height;
+
+    if (canvas_field_rows != 0) {
+        y = 2 * y + canvas_field_start;
+        band = band_left = canvas_field_rows;
+    }
+#endif
+
+    unsigned int left = (unsigned int)x + 40;
+    unsigned int right = left + (unsigned int)width - 1;
+    uint8_t* row = canvas_draw_buffer + y * CANVAS_ROW_BYTES + left / 8;
+
+    // Partial bytes on either end, full ones in between.
+    int middle = (int)(right / 8) - (int)(left / 8) - 1;
+    uint8_t first_mask = 0xFF << (left & 7);
+    uint8_t last_mask = 0xFF >> (7 - (right & 7));
+
+    if (middle < 0)
+        first_mask &= last_mask;
+
+    while (height-- > 0) {
+        row[0] = (row[0] & ~first_mask) | (fill_color & first_mask);
+
+        if (middle >= 0) {
+            memset(row + 1, fill_color, middle);
+            row[middle + 1] = (row[middle + 1] & ~last_mask) | (fill_color & last_mask);
+        }
+
+        row += CANVAS_ROW_BYTES;
+
+#if VID84_INTERLACE
+        if (--band_left == 0) {
+            row += band * CANVAS_ROW_BYTES;
+            band_left = band;
+        }
+#endif
+    }
+}
+#else
+// Fills a rectangle in canvas space. X values need moved forward 40px to be centered
+// in the viewport.
+static inline void fill_canvas_rectangle(int x, int y, int width, int height)
+{
+    VID84_FILL_HOOK(x, y, width, height);
+
+#if VID84_TELEMETRY
+    telemetry_fills++;
+#endif
+
+#if VID84_FILL_BACKEND == FILL_BACKEND_SPANS
+#if VID84_INTERLACE
+    // Rows left before the field skips over the other's.
+    int band = height;
+    int band_left = height;
+
+    if (canvas_field_rows != 0) {
+        y = 2 * y + canvas_field_start;
+        band = band_left = canvas_field_rows;
+    }
+#endif
+
+    uint8_t* row = &gfx_vbuffer[y][x + 40];
+
+    while (height-- > 0) {
+        memset(row, fill_color, width);
+        row += GFX_LCD_WIDTH;
+
+#if VID84_INTERLACE
+        if (--band_left == 0) {
+            row += band * GFX_LCD_WIDTH;
+            band_left = band;
+        }
+#endif
+    }
+#else
+#if VID84_INTERLACE
+    // A fill for each of the field's rows the rectangle covers.
+    if (canvas_field_rows != 0) {
+        for (y = 2 * y + canvas_field_start; height > 0; height -= canvas_field_rows, y += 2 * canvas_field_rows) {
+#if VID84_FILL_BACKEND == FILL_BACKEND_NOCLIP
+            gfx_FillRectangle_NoClip(x + 40, y, width, canvas_field_rows);
+#else
+            gfx_FillRectangle(x + 40, y, width, canvas_field_rows);
+#endif
+        }
+        return;
+    }
+#endif
+
+#if VID84_FILL_BACKEND == FILL_BACKEND_NOCLIP
+    gfx_FillRectangle_NoClip(x + 40, y, width, height);
+#else
+    gfx_FillRectangle(x + 40, y, width, height);
+#endif
+#endif
+}
+#endif
+
+// Gets a buffer ready to draw the first frame in, off screen, so whatever's up now
+// stays up until begin_canvas.
+void prepare_canvas(void)
+{
+#if VID84_LCD_1BPP
+    canvas_buffers[0] = (uint8_t*)lcd_Ram + GFX_LCD_WIDTH * GFX_LCD_HEIGHT;
+    canvas_buffers[1] = canvas_buffers[0] + CANVAS_BUFFER_SIZE;
+    memset(canvas_buffers[0], 0, CANVAS_BUFFER_SIZE * 2);
+    canvas_draw_buffer = canvas_buffers[0];
+#else
+    gfx_SetDrawBuffer();
+#endif
+}
+
+// Puts the first frame on screen. With double buffering, we're drawing to the back
+// buffer after this, otherwise straight to the screen.
+void begin_canvas(void)
+{
+#if VID84_LCD_1BPP
+    saved_lcd_palette[0] = lcd_Palette[0];
+    saved_lcd_palette[1] = lcd_Palette[1];
+    lcd_Palette[0] = 0x0000;
+    lcd_Palette[1] = 0xFFFF;
+
+    lcd_UpBase = (uintptr_t)canvas_buffers[0];
+    lcd_IntAcknowledge = LCD_INT_LNBU;
+    saved_lcd_control = lcd_Control;
+    lcd_Control = (saved_lcd_control & ~(LCD_CONTROL_BPP_MASK | LCD_CONTROL_PIXEL_ORDER)) | LCD_CONTROL_1BPP;
+
+#if VID84_DOUBLE_BUFFER
+    canvas_draw_buffer = canvas_buffers[1];
+#endif
+#else
+    gfx_SwapDraw();
+#if !VID84_DOUBLE_BUFFER
+    gfx_SetDrawScreen();
+#endif
+#endif
+}
+
+// Puts the frame we just drew on screen, and starts drawing to the other buffer.
+void show_canvas(void)
+{
+#if VID84_LCD_1BPP
+    lcd_UpBase = (uintptr_t)canvas_draw_buffer;
+    lcd_IntAcknowledge = LCD_INT_LNBU;
+    canvas_draw_buffer = (canvas_draw_buffer == canvas_buffers[0]) ? canvas_buffers[1] : canvas_buffers[0];
+#else
+    gfx_SwapDraw();
+#endif
+}
+
+// The LCD might still be reading from the buffer we're about to draw over, until
+// it picks up the base address from the last swap. graphx waits on its own.
+void wait_for_canvas(void)
+{
+#if VID84_LCD_1BPP && VID84_DOUBLE_BUFFER
+    while (!(lcd_IntStatus & LCD_INT_LNBU));
+#endif
+}
+
+#if VID84_DOUBLE_BUFFER
+// Copies the canvas on screen into the back buffer. The borders are in both already,
+// so in 8bpp mode only the canvas itself goes over.
+void copy_shown_canvas(void)
+{
+#if VID84_LCD_1BPP
+    const uint8_t* shown = (canvas_draw_buffer == canvas_buffers[0]) ? canvas_buffers[1] : canvas_buffers[0];
+
+    VID84_COPY_HOOK(CANVAS_BUFFER_SIZE);
+    memcpy(canvas_draw_buffer, shown, CANVAS_BUFFER_SIZE);
+#else
+    VID84_COPY_HOOK(240 * 240);
+    gfx_BlitRectangle(gfx_screen, 40, 0, 240, 240);
+#endif
+}
+#endif
+
+// Back to how graphx left the LCD.
+void end_canvas(void)
+{
+#if VID84_LCD_1BPP
+    lcd_Control = saved_lcd_control;
+    lcd_UpBase = (uintptr_t)lcd_Ram;
+    lcd_Palette[0] = saved_lcd_palette[0];
+    lcd_Palette[1] = saved_lcd_palette[1];
+#endif
+}
+
+// Rectangle sizes for each layout, before scaling. Markers only ever show up where a
+// rectangle would start, so each of these gets all four of its bytes at once.
+#define RECT_SIZE_WIDTH(d)          ((d)[2])
+#define RECT_SIZE_HEIGHT(d)         ((d)[3])
+#define RECT_CORNERS_WIDTH(d)       ((d)[2] - (d)[0] + 1)  // Inclusive, the far edge is one more pixel out.
+#define RECT_CORNERS_HEIGHT(d)      ((d)[3] - (d)[1] + 1)
+#define RECT_V1_WIDTH(d)            v1_rectangle_length((d)[0], (d)[2])
+#define RECT_V1_HEIGHT(d)           v1_rectangle_length((d)[1], (d)[3])
+
+static inline int v1_rectangle_length(unsigned char start, unsigned char end)
+{
+    int length = abs((int)end - (int)start);
+
+    // Sometimes really precise rectangles are going to return 0 values,
+    // force these to one px so things are still visible.
+    return (length == 0) ? 1 : length;
+}
+
+// Every layout and scale factor gets its own copy of the rectangle loops, with the
+// scale as a constant. The compiler turns x1 into nothing and x2/x4 into shifts,
+// instead of us multiplying every single coordinate by a variable.
+#define DEFINE_RECTANGLE_READER(name, scale, width_of, height_of) \
+    static const unsigned char* draw_rectangles_##name(const unsigned char* data) \
+    { \
+        while (data[0] < VIDEO_CHUNK_END) { \
+            fill_canvas_rectangle((int)data[0] * (scale), (int)data[1] * (scale), \
+            width_of(data) * (scale), height_of(data) * (scale)); \
+            data += 4; \
+        } \
+        return data; \
+    } \
+    static const unsigned char* make_rectangle_##name(vid84rect_t* rect, const unsigned char* data) \
+    { \
+        rect->x = data[0] * (scale); \
+        rect->y = data[1] * (scale); \
+        rect->width = width_of(data) * (scale); \
+        rect->height = height_of(data) * (scale); \
+        return data + 4; \
+    }
+
+#define DEFINE_RECTANGLE_READERS(format, width_of, height_of) \
+    DEFINE_RECTANGLE_READER(format##_x1, 1, width_of, height_of) \
+    DEFINE_RECTANGLE_READER(format##_x2, 2, width_of, height_of) \
+    DEFINE_RECTANGLE_READER(format##_x3, 3, width_of, height_of) \
+    DEFINE_RECTANGLE_READER(format##_x4, 4, width_of, height_of) \
+    DEFINE_RECTANGLE_READER(format##_x5, 5, width_of, height_of) \
+    DEFINE_RECTANGLE_READER(format##_x6, 6, width_of, height_of)
+
+DEFINE_RECTANGLE_READERS(v1, RECT_V1_WIDTH, RECT_V1_HEIGHT)
+DEFINE_RECTANGLE_READERS(corners, RECT_CORNERS_WIDTH, RECT_CORNERS_HEIGHT)
+DEFINE_RECTANGLE_READERS(size, RECT_SIZE_WIDTH, RECT_SIZE_HEIGHT)
+
+// The last packed rectangle read, unscaled. Every one after it is stored relative to it.
+unsigned char packed_x;
+unsigned char packed_y;
+unsigned char packed_width;
+unsigned char packed_height;
+
+// Packed rectangles start over from a zero sized one in the corner at the start of
+// every frame, and again after a delta's color switch.
+static inline void reset_packed_rectangles(void)
+{
+    packed_x = 0;
+    packed_y = 0;
+    packed_width = 0;
+}
+
+// Reads the packed rectangle at data into packed_*, and returns where the next one starts.
+static inline const unsigned char* read_packed_rectangle(const unsigned char* data)
+{
+    unsigned char code = data[0];
+    unsigned char size;
+
+    if (code < PACKED_RECT_ROWS_DOWN) {
+        packed_x += packed_width + code;
+        size = data[1];
+        data += 2;
+    } else if (code < PACKED_RECT_SAME_ROW_LARGE) {
+        packed_y += code - PACKED_RECT_ROWS_DOWN + 1;
+        packed_x = data[1];
+        size = data[2];
+        data += 3;
+    } else {
+        if (code < PACKED_RECT_ROWS_DOWN_LARGE) {
+            packed_x += packed_width + (code - PACKED_RECT_SAME_ROW_LARGE);
+            data += 1;
+        } else if (code < PACKED_RECT_ABSOLUTE) {
+            packed_y += code - PACKED_RECT_ROWS_DOWN_LARGE;
+            packed_x = data[1];
+            data += 2;
+        } else {
+            packed_x = data[1];
+            packed_y = data[2];
+            data += 3;
+        }
+
+        packed_width = data[0] + 1;
+        packed_height = data[1] + 1;
+        return data + 2;
+    }
+
+    packed_width = (size >> 4) + 1;
+    packed_height = (size & 0x0F) + 1;
+    return data;
+}
+
+#define DEFINE_PACKED_RECTANGLE_READER(scale) \
+    static const unsigned char* draw_rectangles_packed_x##scale(const unsigned char* data) \
+    { \
+        while (data[0] < VIDEO_CHUNK_END) { \
+            data = read_packed_rectangle(data); \
+            fill_canvas_rectangle((int)packed_x * (scale), (int)packed_y * (scale), \
+            (int)packed_width * (scale), (int)packed_height * (scale)); \
+        } \
+        return data; \
+    } \
+    static const unsigned char* make_rectangle_packed_x##scale(vid84rect_t* rect, const unsigned char* data) \
+    { \
+        data = read_packed_rectangle(data); \
+        rect->x = packed_x * (scale); \
+        rect->y = packed_y * (scale); \
+        rect->width = packed_width * (scale); \
+        rect->height = packed_height * (scale); \
+        return data; \
+    }
+
+DEFINE_PACKED_RECTANGLE_READER(1)
+DEFINE_PACKED_RECTANGLE_READER(2)
+DEFINE_PACKED_RECTANGLE_READER(3)
+DEFINE_PACKED_RECTANGLE_READER(4)
+DEFINE_PACKED_RECTANGLE_READER(5)
+DEFINE_PACKED_RECTANGLE_READER(6)
+
+typedef struct {
+    // Draws rectangles until it hits a marker, and returns where the marker is.
+    const unsigned char* (*draw)(const unsigned char* data);
+    // Turns the rectangle at data into something we can queue up, and returns where the next one starts.
+    const unsigned char* (*make)(vid84rect_t* rect, const unsigned char* data);
+} vid84rectreader_t;
+
+#define RECTANGLE_READERS(format) \
+    { \
+        { draw_rectangles_##format##_x1, make_rectangle_##format##_x1 }, \
+        { draw_rectangles_##format##_x2, make_rectangle_##format##_x2 }, \
+        { draw_rectangles_##format##_x3, make_rectangle_##format##_x3 }, \
+        { draw_rectangles_##format##_x4, make_rectangle_##format##_x4 }, \
+        { draw_rectangles_##format##_x5, make_rectangle_##format##_x5 }, \
+        { draw_rectangles_##format##_x6, make_rectangle_##format##_x6 }, \
+    }
+
+// Indexed by RECT_FORMAT_* and then scale factor.
+const vid84rectreader_t rectangle_readers[4][6] = {
+    RECTANGLE_READERS(v1),
+    RECTANGLE_READERS(corners),
+    RECTANGLE_READERS(size),
+    RECTANGLE_READERS(packed),
+};
+
+// Span frames get the same treatment. Runs are a row tall, and stored a pixel short
+// since they're never empty.
+#define DEFINE_SPAN_READER(scale) \
+    static const unsigned char* draw_spans_x##scale(const unsigned char* data) \
+    { \
+        while (data[0] < VIDEO_CHUNK_END) { \
+            int y = (int)data[0] * (scale); \
+            int count = data[1]; \
+            data += 2; \
+            while (count-- > 0) { \
+                fill_canvas_rectangle((int)data[0] * (scale), y, ((int)data[1] + 1) * (scale), (scale)); \
+                data += 2; \
+            } \
+        } \
+        return data; \
+    }
+
+DEFINE_SPAN_READER(1)
+DEFINE_SPAN_READER(2)
+DEFINE_SPAN_READER(3)
+DEFINE_SPAN_READER(4)
+DEFINE_SPAN_READER(5)
+DEFINE_SPAN_READER(6)
+
+// Indexed by scale factor.
+const unsigned char* (* const span_readers[6])(const unsigned char* data) = {
+    draw_spans_x1, draw_spans_x2, draw_spans_x3, draw_spans_x4, draw_spans_x5, draw_spans_x6,
+};
+
+// The loops for the video being played, picked once the header is read.
+const vid84rectreader_t* video_rect_reader;
+const unsigned char* (*video_span_reader)(const unsigned char* data);
+
+void init_rectangle_reader(void)
+{
+    video_rect_reader = &rectangle_readers[video_rect_format][video_scale_factor - 1];
+    video_span_reader = span_readers[video_scale_factor - 1];
+}
+
+// The bitmask of the tile frame being drawn, if it is one.
+const unsigned char* frame_tile_mask;
+
+// Clears the tiles a tile frame changes. Tiles next to each other on a row get
+// cleared together, so it's one fill for every run of them.
+void clear_changed_tiles(const unsigned char* mask)
+{
+    int size = VIDEO_TILE_SIZE * (int)video_scale_factor;
+    int tile = 0;
+
+    set_fill_color(255);
+
+    for (int y = 0; y < 240; y += size) {
+        int height = (240 - y < size) ? 240 - y : size;
+        int run_start = -1;
+
+        for (int x = 0; x < 240; x += size, tile++) {
+            bool changed = (mask[tile >> 3] >> (tile & 7)) & 1;
+
+            if (changed && run_start < 0) {
+                run_start = x;
+            } else if (!changed && run_start >= 0) {
+                fill_canvas_rectangle(run_start, y, x - run_start, height);
+                run_start = -1;
             }
         }
 
-        // Check if we still have time to spare or if we've hit our budget.
-        curr_time = clock();
-        frame_time = (int)(1000 * (curr_time - start_time) / CLOCKS_PER_SEC);
-        int off_time = time_per_frame_ms - frame_time;
+        if (run_start >= 0)
+            fill_canvas_rectangle(run_start, y, 240 - run_start, height);
+    }
+}
+
+// Frames are paced off a hardware timer counting up at 32768Hz. Every deadline is
+// worked out from the one before it, carrying the remainder along, so after n frames
+// we're exactly n/fps seconds in -- 24fps really is 41.67ms a frame, not 41ms --
+// and running late on one frame doesn't push every frame after it back.
+#define PACING_TIMER                2   // Timer 1 belongs to the C runtime.
+#define PACING_TICKS_PER_SECOND     32768
+#define PACING_CHECK_INTERVAL       8   // Rectangles to queue up between looking at the timer.
+
+uint32_t frame_deadline;
+unsigned int frame_period_ticks;
+unsigned int frame_period_remainder;
+unsigned int frame_remainder_total;
+
+void init_frame_timer(void)
+{
+    timer_Disable(PACING_TIMER);
+    timer_Set(PACING_TIMER, 0);
+    timer_Enable(PACING_TIMER, TIMER_32K, TIMER_NOINT, TIMER_UP);
+}
+
+void start_frame_pacing(void)
+{
+    frame_period_ticks = PACING_TICKS_PER_SECOND / (unsigned int)video_fps;
+    frame_period_remainder = PACING_TICKS_PER_SECOND % (unsigned int)video_fps;
+    frame_remainder_total = 0;
+
+    // The first frame is due right away.
+    frame_deadline = timer_Get(PACING_TIMER);
+}
+
+void advance_frame_deadline(void)
+{
+    frame_deadline += frame_period_ticks;
+
+    frame_remainder_total += frame_period_remainder;
+    if (frame_remainder_total >= (unsigned int)video_fps) {
+        frame_remainder_total -= (unsigned int)video_fps;
+        frame_deadline++;
+    }
+}
 
-        // We don't, clean up and leave.
-        if (off_time <= 0) {
-            // We didn't finish a rectangle, let the live decoder re-do that one.
-            if (rect_data_index != 3) {
-                (*last_data_index) -= rect_data_index;
+bool frame_deadline_passed(void)
+{
+    // Signed difference, so this still works when the timer wraps around.
+    return (int32_t)(timer_Get(PACING_TIMER) - frame_deadline) >= 0;
+}
+
+void wait_for_frame_deadline(void)
+{
+    while (!frame_deadline_passed());
+}
+
+#if VID84_COMPRESSION
+uint32_t video_block_unpack_ticks = 0;  // The longest decompressing a block has taken.
+
+// Decompresses the next block ahead of time, if there's room for it in the ring and
+// it looks like it'll be done before the deadline.
+void prefetch_video_block(void)
+{
+    if (!video_compressed || video_blocks_unpacked >= video_block_count)
+        return;
+    if (video_blocks_unpacked > video_block_floor + VIDEO_BLOCK_BUFFERS - 1)
+        return;
+
+    uint32_t start = timer_Get(PACING_TIMER);
+    if ((int32_t)(frame_deadline - start) < (int32_t)video_block_unpack_ticks)
+        return;
+
+    unpack_video_block();
+
+    uint32_t ticks = timer_Get(PACING_TIMER) - start;
+    if (ticks > video_block_unpack_ticks)
+        video_block_unpack_ticks = ticks;
+}
+#endif
+
+// How many frames were skipped to stay in sync.
+unsigned int frames_dropped = 0;
+
+int drop_late_frames(const unsigned char** cursor, int next_frame)
+{
+    // How many frames should already be up by now, besides the next one.
+    uint32_t late = timer_Get(PACING_TIMER) - frame_deadline;
+    if ((int32_t)late < (int32_t)frame_period_ticks)
+        return 0;
+
+    int behind = 0;
+    while ((int32_t)late >= (int32_t)frame_period_ticks) {
+        late -= frame_period_ticks;
+        behind++;
+    }
+
+    // Any frame can be skipped in version 1, they're all drawn from scratch. Deltas
+    // can't be, so we can only jump as far as the last keyframe we should be past.
+    int skip = 0;
+    if ((int)video_version == 1) {
+        for (; skip < behind && **cursor != 0xFE; skip++)
+            *cursor = skip_frame(*cursor);
+    } else if (video_frame_index != -1) {
+        for (int i = behind; i > 0; i--) {
+            const unsigned char* frame = seek_to_frame(next_frame + i);
+
+            if (frame != NULL && FRAME_STARTS_BLANK(frame[1])) {
+                *cursor = frame + 1;
+                skip = i;
+                break;
             }
+        }
+    } else {
+        const unsigned char* frame = *cursor;
+        int periods = 0;
+
+        // Repeats are on for more than one frame time, so this counts those instead.
+        while (true) {
+            periods += FRAME_PERIODS(frame);
+            frame = skip_frame(frame);
+            if (periods > behind || *frame == 0xFE)
+                break;
 
-            time_to_process = false;
-            break;
+            if (FRAME_STARTS_BLANK(*frame)) {
+                *cursor = frame;
+                skip = periods;
+            }
         }
     }
+
+    // The frames we skipped still count towards keeping time.
+    for (int i = 0; i < skip; i++)
+        advance_frame_deadline();
+
+    frames_dropped += skip;
+    return skip;
+}
+
+#if VID84_CONTROLS
+// Playback controls. The keypad is left scanning on its own while the video plays,
+// so checking them is just reading its registers, once a frame.
+#define CONTROL_SEEK_SECONDS        5
+
+#define CONTROL_KEY_PAUSE           0x01    // [2nd] or [enter], again to carry on.
+#define CONTROL_KEY_QUIT            0x02    // [clear]
+#define CONTROL_KEY_BACK            0x04    // [left]
+#define CONTROL_KEY_FORWARD         0x08    // [right]
+
+// Keys down as of the last check, so holding one only counts once.
+uint8_t control_keys_down = 0;
+
+static uint8_t read_control_keys(void)
+{
+    uint8_t keys = 0;
+
+    if ((kb_Data[1] & kb_2nd) || (kb_Data[6] & kb_Enter))
+        keys |= CONTROL_KEY_PAUSE;
+    if (kb_Data[6] & kb_Clear)
+        keys |= CONTROL_KEY_QUIT;
+    if (kb_Data[7] & kb_Left)
+        keys |= CONTROL_KEY_BACK;
+    if (kb_Data[7] & kb_Right)
+        keys |= CONTROL_KEY_FORWARD;
+
+    return keys;
+}
+
+void start_controls(void)
+{
+    kb_SetMode(MODE_3_CONTINUOUS);
+
+    // Whatever started playback could still be held down.
+    control_keys_down = read_control_keys();
+}
+
+void end_controls(void)
+{
+    kb_Reset();
+}
+
+// The controls pressed since the last check.
+uint8_t poll_controls(void)
+{
+    uint8_t keys = read_control_keys();
+    uint8_t pressed = keys & ~control_keys_down;
+
+    control_keys_down = keys;
+    return pressed;
+}
+
+// Holds the frame on screen until pause is pressed again, or another control is.
+// Returns the other controls, if that's what it was.
+uint8_t pause_playback(void)
+{
+    uint8_t keys;
+
+    do {
+        keys = poll_controls();
+    } while (keys == 0);
+
+    return keys & ~CONTROL_KEY_PAUSE;
+}
+
+// Whether playback can start from frame, without the ones before it.
+static bool frame_starts_playback(int frame)
+{
+    return (int)video_version == 1 || FRAME_STARTS_BLANK(video_byte(video_frame_offset(frame) + 1));
+}
+
+// The frame between first and last that playback can start from, nearest to target.
+// Deltas need the frames before them, so that's a keyframe. -1 if there isn't one.
+int nearest_starting_frame(int target, int first, int last)
+{
+    if (first > last)
+        return -1;
+    if (target < first)
+        target = first;
+    if (target > last)
+        target = last;
+
+    for (int distance = 0; target - distance >= first || target + distance <= last; distance++) {
+        if (target - distance >= first && frame_starts_playback(target - distance))
+            return target - distance;
+        if (target + distance <= last && frame_starts_playback(target + distance))
+            return target + distance;
+    }
+
+    return -1;
 }
 
-int prerender_first_frame()
+// Where playback goes from next_frame for a skip back or forward, or -1 for nowhere.
+// Finding it takes the frame index.
+int seek_target(uint8_t keys, int next_frame)
 {
-    // Start at 0x9 -- 0x8 is always a frame start, we can ignore it.
-    int last_data_index = 9;
-    clock_t start_time = clock();
-    int time_per_frame_ms = 500; // give it half a second to try and fill the queue.
+    int distance = CONTROL_SEEK_SECONDS * (int)video_fps;
+
+    if (video_frame_index == -1)
+        return -1;
+
+    // Back goes from the frame on screen, which is the one before.
+    if (keys & CONTROL_KEY_BACK)
+        return nearest_starting_frame(next_frame - 1 - distance, 0, next_frame - 2);
+    if (keys & CONTROL_KEY_FORWARD)
+        return nearest_starting_frame(next_frame - 1 + distance, next_frame, video_frame_count - 1);
 
-    process_next_frame(&last_data_index, start_time, time_per_frame_ms);
-    return last_data_index;
+    return -1;
 }
 
-void process_rectangle_queue(void)
+// Drops whatever's been read of the next frame, and carries on from frame instead.
+// Returns the cursor for it.
+const unsigned char* seek_playback(int frame)
 {
-    // Iterate through the queue.
-    for(int i = 0; i < RECTANGLE_QUEUE_COUNT; i++) {
-        // It's a complete rectangle
-        if (queued_rectangles[i].x != -1) {
-            // X values need moved forward 40px to be centered in the viewport
-            queued_rectangles[i].x += 40;
-            queued_rectangles[i].x2 += 40;
+    queued_frame_type = NO_QUEUED_FRAME_TYPE;
+    rect_queue_head = rect_queue_tail;
 
-            int width = abs(queued_rectangles[i].x2 - queued_rectangles[i].x);
-            int height = abs(queued_rectangles[i].y2 - queued_rectangles[i].y);
+    // It's due right away, and the clock carries on from there.
+    start_frame_pacing();
 
-            // Sometimes really precise rectangles are going to return 0 values,
-            // force these to one px so things are still visible.
-            if (height == 0) height = (int)video_scale_factor;
-            if (width == 0) width = (int)video_scale_factor;
+    return seek_to_frame(frame) + 1;
+}
+#endif
+
+#if VID84_TELEMETRY
+// Playback stats, saved as-is to the VID84TLM AppVar after playback so they can be
+// pulled off with TI-Connect and compared between builds. Everything is little
+// endian with no padding, and times are in 32768Hz timer ticks.
+#define TELEMETRY_APPVAR            "VID84TLM"
+#define TELEMETRY_VERSION           1
+#define TELEMETRY_BUCKET_TICKS      32      // About 1ms per histogram bucket.
+#define TELEMETRY_BUCKETS           128     // Anything slower lands in the last one.
+#define TELEMETRY_LOG_FRAMES        256     // Frames from the start of the video that get their own record.
+
+// Build options the stats came from.
+#define TELEMETRY_BUILD_DOUBLE_BUFFER   0x01
+#define TELEMETRY_BUILD_FRAME_DROP      0x02
+#define TELEMETRY_BUILD_LCD_1BPP        0x04
+#define TELEMETRY_BUILD_APPVAR          0x08
+
+// Double buffered builds draw the whole next frame instead of queueing it up during
+// the off-time, so their prefetch and queue stats are all ones (n/a) rather than 0.
+#define TELEMETRY_NOT_APPLICABLE        0xFFFFFFFF
 
-            gfx_FillRectangle(queued_rectangles[i].x, queued_rectangles[i].y, width, height);
-        }
-        // It's not, don't bother continuing to iterate
-        else {
+typedef struct {
+    uint16_t draw_ticks;        // Decoding and drawing it, including redrawing the frame before a delta.
+    uint16_t prefetch_ticks;    // Pre-processing the next frame during its off-time, n/a if double buffered.
+    uint16_t fills;             // Rectangles it filled, counting the canvas clear.
+    uint16_t bytes;             // Video data it took up.
+    uint8_t queue_fill;         // Rectangles queued up for the next frame, n/a if double buffered.
+    uint8_t overrun;            // 1 if it wasn't ready by its deadline.
+} vid84framestat_t;
+
+typedef struct {
+    char magic[5];              // Always '84TLM'.
+    uint8_t version;            // TELEMETRY_VERSION.
+    uint8_t build;              // TELEMETRY_BUILD_* bits.
+    uint8_t fill_backend;       // VID84_FILL_BACKEND.
+    uint8_t fps;
+    uint8_t scale_factor;
+    uint16_t frames;            // Frames drawn, not counting dropped ones or held repeats.
+    uint16_t frames_dropped;
+    uint16_t frames_overrun;
+    uint16_t min_draw_ticks;
+    uint16_t max_draw_ticks;
+    uint32_t total_draw_ticks;
+    uint32_t total_prefetch_ticks;  // n/a if double buffered.
+    uint32_t total_fills;
+    uint32_t total_bytes;
+    uint16_t histogram[TELEMETRY_BUCKETS]; // Frames by draw time, TELEMETRY_BUCKET_TICKS per bucket.
+    vid84framestat_t log[TELEMETRY_LOG_FRAMES];
+} vid84telemetry_t;
+
+vid84telemetry_t telemetry;
+vid84framestat_t telemetry_frame;
+uint32_t telemetry_frame_start;
+int telemetry_frame_offset;
+
+static uint16_t telemetry_clamp(uint32_t value)
+{
+    return (value > 0xFFFF) ? 0xFFFF : (uint16_t)value;
+}
+
+void telemetry_begin_frame(const unsigned char* cursor)
+{
+    memset(&telemetry_frame, 0, sizeof(telemetry_frame));
+#if VID84_DOUBLE_BUFFER
+    telemetry_frame.prefetch_ticks = (uint16_t)TELEMETRY_NOT_APPLICABLE;
+    telemetry_frame.queue_fill = (uint8_t)TELEMETRY_NOT_APPLICABLE;
+#endif
+    telemetry_fills = 0;
+    telemetry_frame_offset = video_offset(cursor);
+    telemetry_frame_start = timer_Get(PACING_TIMER);
+}
+
+void telemetry_frame_drawn(const unsigned char* cursor)
+{
+    telemetry_frame.draw_ticks = telemetry_clamp(timer_Get(PACING_TIMER) - telemetry_frame_start);
+    telemetry_frame.fills = telemetry_clamp(telemetry_fills);
+    // A video cut short by bad data ends on something with no offset.
+    int offset = video_offset(cursor);
+    telemetry_frame.bytes = (offset > telemetry_frame_offset) ? telemetry_clamp(offset - telemetry_frame_offset) : 0;
+}
+
+void telemetry_frame_prefetched(uint32_t ticks)
+{
+    telemetry_frame.prefetch_ticks = telemetry_clamp(ticks);
+
+    unsigned int queued = rect_queue_length();
+    telemetry_frame.queue_fill = (queued > UINT8_MAX) ? UINT8_MAX : queued;
+}
+
+void telemetry_end_frame(bool overrun)
+{
+    unsigned int bucket = telemetry_frame.draw_ticks / TELEMETRY_BUCKET_TICKS;
+    if (bucket >= TELEMETRY_BUCKETS)
+        bucket = TELEMETRY_BUCKETS - 1;
+
+    telemetry_frame.overrun = overrun ? 1 : 0;
+
+    if (telemetry.frames < TELEMETRY_LOG_FRAMES)
+        telemetry.log[telemetry.frames] = telemetry_frame;
+
+    if (telemetry.frames == 0 || telemetry_frame.draw_ticks < telemetry.min_draw_ticks)
+        telemetry.min_draw_ticks = telemetry_frame.draw_ticks;
+    if (telemetry_frame.draw_ticks > telemetry.max_draw_ticks)
+        telemetry.max_draw_ticks = telemetry_frame.draw_ticks;
+
+    telemetry.frames++;
+    telemetry.frames_overrun += telemetry_frame.overrun;
+    telemetry.total_draw_ticks += telemetry_frame.draw_ticks;
+#if VID84_DOUBLE_BUFFER
+    telemetry.total_prefetch_ticks = TELEMETRY_NOT_APPLICABLE;
+#else
+    telemetry.total_prefetch_ticks += telemetry_frame.prefetch_ticks;
+#endif
+    telemetry.total_fills += telemetry_frame.fills;
+    telemetry.total_bytes += telemetry_frame.bytes;
+    telemetry.histogram[bucket]++;
+}
+
+// Tenths of a millisecond, it's the least we can print without floats.
+static uint32_t ticks_to_tenth_ms(uint32_t ticks)
+{
+    return ticks * 10000 / PACING_TICKS_PER_SECOND;
+}
+
+static void print_telemetry_time(const char* label, uint32_t ticks, uint8_t y)
+{
+    char line[40];
+    uint32_t tenths = ticks_to_tenth_ms(ticks);
+
+    sprintf(line, "%s%lu.%lums", label, (unsigned long)(tenths / 10), (unsigned long)(tenths % 10));
+    gfx_PrintStringXY(line, 5, y);
+}
+
+void show_telemetry(void)
+{
+    char line[40];
+
+    memcpy(telemetry.magic, "84TLM", 5);
+    telemetry.version = TELEMETRY_VERSION;
+    telemetry.build = (VID84_DOUBLE_BUFFER ? TELEMETRY_BUILD_DOUBLE_BUFFER : 0) |
+    (VID84_FRAME_DROP ? TELEMETRY_BUILD_FRAME_DROP : 0) |
+    (VID84_LCD_1BPP ? TELEMETRY_BUILD_LCD_1BPP : 0) |
+    (VID84_SOURCE_APPVAR ? TELEMETRY_BUILD_APPVAR : 0);
+    telemetry.fill_backend = VID84_FILL_BACKEND;
+    telemetry.fps = video_fps;
+    telemetry.scale_factor = video_scale_factor;
+    telemetry.frames_dropped = telemetry_clamp(frames_dropped);
+
+    // The 95th percentile comes out of the histogram, to the nearest bucket.
+    uint32_t p95_ticks = 0;
+    uint32_t counted = 0;
+    for (int i = 0; i < TELEMETRY_BUCKETS; i++) {
+        counted += telemetry.histogram[i];
+        if (counted * 100 >= (uint32_t)telemetry.frames * 95) {
+            p95_ticks = (uint32_t)(i + 1) * TELEMETRY_BUCKET_TICKS;
             break;
         }
     }
 
-    // Reset the queue
-    init_render_queue();
+    uint32_t frames = (telemetry.frames == 0) ? 1 : telemetry.frames;
+    uint32_t draw_tenths = telemetry.total_draw_ticks / (PACING_TICKS_PER_SECOND / 10);
+    if (draw_tenths == 0)
+        draw_tenths = 1;
+
+    gfx_SetDrawScreen();
+    gfx_FillScreen(255);
+
+    gfx_PrintStringXY("== PLAYBACK STATS ==", 5, 5);
+    sprintf(line, "Frames: %u, %u dropped", (unsigned int)telemetry.frames, (unsigned int)telemetry.frames_dropped);
+    gfx_PrintStringXY(line, 5, 25);
+    sprintf(line, "Overran: %u", (unsigned int)telemetry.frames_overrun);
+    gfx_PrintStringXY(line, 5, 35);
+    print_telemetry_time("Min: ", telemetry.min_draw_ticks, 55);
+    print_telemetry_time("Avg: ", telemetry.total_draw_ticks / frames, 65);
+    print_telemetry_time("P95: <", p95_ticks, 75);
+    print_telemetry_time("Max: ", telemetry.max_draw_ticks, 85);
+    sprintf(line, "Rects filled/sec: %lu", (unsigned long)(telemetry.total_fills * 10 / draw_tenths));
+    gfx_PrintStringXY(line, 5, 105);
+
+    uint8_t handle = ti_Open(TELEMETRY_APPVAR, "w");
+    if (handle != 0 && ti_Write(&telemetry, sizeof(telemetry), 1, handle) == 1)
+        gfx_PrintStringXY("Saved to the VID84TLM AppVar.", 5, 125);
+    else
+        gfx_PrintStringXY("Couldn't save the stats.", 5, 125);
+    if (handle != 0)
+        ti_Close(handle);
+
+    gfx_PrintStringXY("Press any key to exit..", 5, 145);
+    while (!os_GetCSC());
 }
+#endif
+
+// What a frame that can't be read ends the video on.
+const unsigned char video_bad_frame_end = 0xFE;
 
-void begin_decode(int last_data_index)
+// Reads the type of the version 2 frame at cursor, and steps over everything that
+// comes before its rectangles.
+unsigned char read_frame_type(const unsigned char** cursor)
 {
-    bool loop = true;
-    unsigned char data;
+    unsigned char frame_type = **cursor;
+    (*cursor)++;
+
+    reset_packed_rectangles();
+
+#if VID84_INTERLACE
+    // Fields get drawn into every other band of the scale factor's rows.
+    if (frame_type & FRAME_FIELD) {
+        canvas_field_rows = video_scale_factor;
+        canvas_field_start = (frame_type & FRAME_FIELD_ODD) ? video_scale_factor : 0;
+    } else {
+        canvas_field_rows = 0;
+    }
+    frame_type &= FRAME_TYPE_MASK;
+#endif
+
+    // Span frames have to be declared in the header. One that wasn't is bad data,
+    // so the video ends here, on an empty delta, instead of reading on through it.
+    if (frame_type == FRAME_TYPE_SPANS && !video_span_frames) {
+        *cursor = &video_bad_frame_end;
+        return FRAME_TYPE_DELTA;
+    }
+
+    if (frame_type == FRAME_TYPE_TILES) {
+        frame_tile_mask = *cursor;
+        (*cursor) += video_tile_mask_length;
+    }
+
+    return frame_type;
+}
+
+void process_next_frame(const unsigned char** cursor)
+{
+    int queued = 0;
+
+    // Picks up where it left off if some of the frame's already queued.
+    if ((int)video_version >= 2 && queued_frame_type == NO_QUEUED_FRAME_TYPE) {
+        // Repeats are left for the decode loop, they've got nothing to queue.
+        if (**cursor == FRAME_TYPE_REPEAT)
+            return;
+
+#if VID84_LCD_1BPP && VID84_PRERENDER
+        // Neither have frames that are already drawn.
+        if (prerendered_frame(*cursor) != -1)
+            return;
+#endif
+
+        queued_frame_type = read_frame_type(cursor);
+    }
+
+    // Span frames don't go through the queue, they're cheap enough to draw as is.
+    if (queued_frame_type == FRAME_TYPE_SPANS)
+        return;
+
+    // Not EoF, new frame, color switch, or chunk end indicator
+    while (**cursor < VIDEO_CHUNK_END) {
+        unsigned int next = rect_queue_tail + 1;
+        if (next == rect_queue_size)
+            next = 0;
+
+        // Don't do anything if the queue is full.
+        if (next == rect_queue_head)
+            break;
+
+        // Queue the whole rectangle up.
+        *cursor = video_rect_reader->make(&queued_rectangles[rect_queue_tail], *cursor);
+        rect_queue_tail = next;
+        queued++;
+
+        // Check if we've hit our budget every few rectangles. Rectangles are
+        // queued whole, so there's nothing to clean up if we have.
+        if ((queued % PACING_CHECK_INTERVAL) == 0 && frame_deadline_passed())
+            break;
+    }
+}
+
+void fill_video_rectangle(vid84rect_t* rect)
+{
+    fill_canvas_rectangle(rect->x, rect->y, rect->width, rect->height);
+}
 
-    // Defines the time to wait per frame.
-    int time_per_frame_ms = 1000/(int)video_fps;
-    int frame_time;
+void process_rectangle_queue(void)
+{
+    // Draw everything from the head on, which leaves the queue empty.
+    while (rect_queue_head != rect_queue_tail) {
+        fill_video_rectangle(&queued_rectangles[rect_queue_head]);
+
+        rect_queue_head++;
+        if (rect_queue_head == rect_queue_size)
+            rect_queue_head = 0;
+    }
+}
 
+void draw_canvas_borders(void)
+{
     // We have a 240x240 canvas, on a 320x240 display.
     // That's 80px left over space, 40px on each side.
     // Let's add some black borders.
-    gfx_FillRectangle(0, 0, 40, 240); // Left side
-    gfx_FillRectangle(280, 0, 40, 240); // Right side
+    set_fill_color(0);
+#if VID84_INTERLACE
+    canvas_field_rows = 0; // They go all the way down.
+#endif
+    fill_canvas_rectangle(-40, 0, 40, 240); // Left side
+    fill_canvas_rectangle(240, 0, 40, 240); // Right side
+}
 
-    // heheh.
-    while(loop) {
-        // Define clocks and start timer
-        clock_t start_time, end_time;
-        start_time = clock();
-
-        // Blank Canvas
-        gfx_SetColor(255);
-        gfx_FillRectangle(40, 0, 240, 240);
-        gfx_SetColor(0);
-
-        // The rectangle we are going to be drawing.
-        int rect_data_index = 0;
-        vid84rect_t rectangle;
-
-        // Start decoding and rendering the frame.
-        bool decoding_frame = true;
-        while(decoding_frame) {
-            // If we were processing rectangles during our off-time,
-            // draw them.
-            if (queued_rectangles[0].x != -1)
-                process_rectangle_queue();
-
-            data = video_bin[last_data_index];
-
-            // New frame or EoF
-            if (data == 0xFF || data == 0xFE) {
-                decoding_frame = false;
-                break;
-            }
+// Moves cursor from the marker a frame ended at on to the next frame, and returns
+// what's there: 0xFF for another frame, or the 0xFE end code.
+unsigned char start_next_frame(const unsigned char** cursor)
+{
+    unsigned char data = **cursor;
+
+    // The next frame is in the next AppVar.
+    if (data == VIDEO_CHUNK_END) {
+        *cursor = next_video_chunk(*cursor);
+        data = **cursor;
+    }
+
+    // Step over the next frame's indicator, leave the EoF one be.
+    if (data == 0xFF)
+        (*cursor)++;
+
+    return data;
+}
+
+unsigned char draw_frame(const unsigned char** cursor)
+{
+    unsigned char data;
+    unsigned char frame_type = FRAME_TYPE_KEY;
+
+#if VID84_LCD_1BPP && VID84_PRERENDER
+    // Drawn while the prompt was up, it just needs copying in.
+    int slot = prerendered_frame(*cursor);
+    if (slot != -1) {
+        VID84_COPY_HOOK(CANVAS_BUFFER_SIZE);
+        memcpy(canvas_draw_buffer, prerender_slot(slot), CANVAS_BUFFER_SIZE);
+        *cursor = prerendered_frame_end[slot];
+        return (**cursor == 0xFE) ? 0xFE : 0xFF;
+    }
+#endif
+
+    // Version 2 frames say whether they start from a blank canvas.
+    if ((int)video_version >= 2) {
+        if (queued_frame_type != NO_QUEUED_FRAME_TYPE) {
+            frame_type = queued_frame_type;
+            queued_frame_type = NO_QUEUED_FRAME_TYPE;
+        } else {
+            frame_type = read_frame_type(cursor);
+        }
+    }
+
+    // Blank Canvas
+    if (FRAME_STARTS_BLANK(frame_type)) {
+        int height = 240;
+
+#if VID84_INTERLACE
+        // A field only clears its own rows, half the canvas.
+        if (canvas_field_rows != 0)
+            height = 120;
+#endif
+
+        set_fill_color(255);
+        fill_canvas_rectangle(0, 0, 240, height);
+    } else if (frame_type == FRAME_TYPE_TILES) {
+        clear_changed_tiles(frame_tile_mask);
+    }
+    set_fill_color(0);
+
+#if !VID84_DOUBLE_BUFFER
+    // If we were processing rectangles during our off-time,
+    // draw them.
+    if (rect_queue_head != rect_queue_tail)
+        process_rectangle_queue();
+#endif
+
+    // Start decoding and rendering the frame.
+    while(true) {
+        if (frame_type == FRAME_TYPE_SPANS) {
+            *cursor = video_span_reader(*cursor);
+            data = **cursor;
+            break;
+        }
+
+        *cursor = video_rect_reader->draw(*cursor);
+        data = **cursor;
+
+        // New frame, EoF, or the end of this chunk
+        if (data != DELTA_COLOR_SWITCH)
+            break;
+
+        // The rest of this delta is pixels turning white.
+        set_fill_color(255);
+        reset_packed_rectangles();
+        (*cursor)++;
+    }
+
+    return start_next_frame(cursor);
+}
 
-            // Throw the data where it needs to be.
-            switch(rect_data_index) {
-                case 0: rectangle.x = (int)data * (int)video_scale_factor; break;
-                case 1: rectangle.y = (int)data * (int)video_scale_factor; break;
-                case 2: rectangle.x2 = (int)data * (int)video_scale_factor; break;
-                case 3: rectangle.y2 = (int)data * (int)video_scale_factor; break;
-                default: break;
+#if VID84_LCD_1BPP && VID84_PRERENDER
+// Draws the keyframes that take up the most video data, a rough stand-in for the
+// most to draw, into the spare slots. Finding them takes the frame index.
+void prerender_keyframes(void)
+{
+    int offsets[PRERENDER_SLOTS];
+    int lengths[PRERENDER_SLOTS];
+    int count = 0;
+
+    if (video_frame_index == -1)
+        return;
+
+    // The first frame gets drawn ahead of time anyway.
+    for (int i = 1; i < video_frame_count; i++) {
+        int offset = video_frame_offset(i);
+        if (!FRAME_STARTS_BLANK(video_byte(offset + 1)))
+            continue;
+
+        int length = ((i + 1 < video_frame_count) ? video_frame_offset(i + 1) : video_data_end) - offset;
+
+        // Heaviest first, the lightest falls off the end once they're all taken.
+        int slot = (count < PRERENDER_SLOTS) ? count++ : PRERENDER_SLOTS;
+        while (slot > 0 && lengths[slot - 1] < length) {
+            if (slot < PRERENDER_SLOTS) {
+                offsets[slot] = offsets[slot - 1];
+                lengths[slot] = lengths[slot - 1];
             }
+            slot--;
+        }
+
+        if (slot < PRERENDER_SLOTS) {
+            offsets[slot] = offset;
+            lengths[slot] = length;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        const unsigned char* cursor = video_pointer(offsets[i]) + 1;
+
+        canvas_draw_buffer = prerender_slot(i);
+        draw_canvas_borders();
+
+        prerendered_frame_start[i] = cursor;
+        draw_frame(&cursor);
+        prerendered_frame_end[i] = cursor;
+    }
+
+    // Only now, or draw_frame would've tried copying them from themselves.
+    prerendered_frame_count = count;
+    canvas_draw_buffer = canvas_buffers[0];
+}
+#endif
+
+// Draws the first frame off screen while the prompt is still up, so playback starts
+// with it already there. Without double buffering, as much of the next frame as
+// fits gets queued up too. Leaves cursor on the next frame, and returns what
+// draw_frame did.
+unsigned char prerender_first_frame(const unsigned char** cursor)
+{
+    prepare_canvas();
+
+#if VID84_LCD_1BPP && VID84_PRERENDER
+    prerender_keyframes();
+#endif
+
+    // Skip the first frame start, it's always there.
+    *cursor = seek_to_frame(0) + 1;
+
+    draw_canvas_borders();
+    unsigned char data = draw_frame(cursor);
+
+#if !VID84_DOUBLE_BUFFER
+    if (data != 0xFE) {
+        // give it half a second to try and fill the queue.
+        frame_deadline = timer_Get(PACING_TIMER) + PACING_TICKS_PER_SECOND / 2;
+        process_next_frame(cursor);
+    }
+#endif
+
+    return data;
+}
+
+#if VID84_DOUBLE_BUFFER
+// Frames of the video on screen longer than this get copied into the back buffer
+// instead of drawn again, see catch_up_back_buffer. A 1bpp copy is small enough to
+// beat redrawing anything but a handful of rectangles, an 8bpp one costs about as
+// much as clearing the canvas.
+#if VID84_LCD_1BPP
+#define REDRAW_MAX_LENGTH           64
+#else
+#define REDRAW_MAX_LENGTH           1024
+#endif
+
+// The back buffer still has the frame from before the one on screen, which started
+// at shown_frame. A frame that builds on the one on screen needs it underneath, so
+// it either gets drawn again or copied over, whichever's less work.
+void catch_up_back_buffer(const unsigned char* shown_frame, const unsigned char* frame)
+{
+    // Anything drawn from a blank canvas is at least a clear, so a copy is never slower.
+    if (FRAME_STARTS_BLANK(*shown_frame) || video_offset(frame) - video_offset(shown_frame) > REDRAW_MAX_LENGTH) {
+        copy_shown_canvas();
+        return;
+    }
+
+    draw_frame(&shown_frame);
+}
+#endif
+
+// Plays the video on from cursor, with the first frame already drawn by
+// prerender_first_frame and data what it ended on.
+void begin_decode(const unsigned char* cursor, unsigned char data)
+{
+    bool loop = true;
 
-            // Increment the rect index
-            rect_data_index++;
+#if VID84_DOUBLE_BUFFER
+    // Where the frame currently on screen started, the back buffer is one behind it
+    // unless a repeat gave it the time to catch up.
+    const unsigned char* shown_frame = seek_to_frame(0) + 1;
+    bool back_buffer_behind = true;
+#endif
 
-            // Time to draw it!
-            if (rect_data_index >= 4) {
-                // X values need moved forward 40px to be centered in the viewport
-                rectangle.x += 40;
-                rectangle.x2 += 40;
+    begin_canvas();
 
-                int width = abs(rectangle.x2 - rectangle.x);
-                int height = abs(rectangle.y2 - rectangle.y);
+#if VID84_DOUBLE_BUFFER
+    // The back buffer needs borders too, they never get touched again after this.
+    draw_canvas_borders();
+#endif
 
-                // Sometimes really precise rectangles are going to return 0 values,
-                // force these to one px so things are still visible.
-                if (height == 0) height = (int)video_scale_factor;
-                if (width == 0) width = (int)video_scale_factor;
+    // The clock starts now.
+    start_frame_pacing();
+    VID84_START_HOOK();
+    int frame_number = 0;
 
-                gfx_FillRectangle(rectangle.x, rectangle.y, width, height);
+    // Frame times left to hold the frame on screen for, from a repeat frame. The
+    // first frame's already up, so it gets held for its own.
+    int frames_held = 1;
 
-                rect_data_index = 0;
+#if VID84_CONTROLS
+    start_controls();
+#endif
+
+    // heheh.
+    while(loop) {
+#if VID84_DOUBLE_BUFFER
+        wait_for_canvas();
+#endif
+
+#if VID84_CONTROLS
+        uint8_t keys = poll_controls();
+
+        if (keys != 0) {
+            // The clock stops while paused, and starts over after.
+            if (keys & CONTROL_KEY_PAUSE) {
+                keys = pause_playback();
+                start_frame_pacing();
             }
 
-            last_data_index++;
+            if (keys & CONTROL_KEY_QUIT)
+                break;
+
+            int frame = seek_target(keys, frame_number);
+            if (frame != -1) {
+                cursor = seek_playback(frame);
+                data = 0xFF;
+                frames_held = 0;
+                frame_number = frame;
+            }
         }
+#endif
 
-        bool end_of_file = false;
+#if VID84_TELEMETRY
+        telemetry_begin_frame(cursor);
+        bool overrun = false;
 
-        if (data == 0xFE)
-            end_of_file = true;
-        else
-            last_data_index++;
+        // A repeat is one frame for the stats, however many frame times it holds for.
+        bool timed = true;
+        bool repeat_started = false;
+#endif
 
-        // Get the End time
-        end_time = clock();
+        bool end_of_file = false;
 
-        // Do we have some free time?
-        frame_time = (int)(1000 * (end_time - start_time) / CLOCKS_PER_SEC);
-        int off_time = time_per_frame_ms - frame_time;
+        // Repeats just hold the frame on screen. The cursor's on the next frame's type,
+        // unless the off-time already queued some of it up.
+        if (frames_held == 0 && (int)video_version >= 2 && queued_frame_type == NO_QUEUED_FRAME_TYPE &&
+        *cursor == FRAME_TYPE_REPEAT) {
+#if VID84_DOUBLE_BUFFER
+            // The back buffer's free for the whole hold, so it catches up to the screen
+            // now. Then nothing needs the shown frame's data, and its block can go.
+            if (back_buffer_behind)
+                catch_up_back_buffer(shown_frame, cursor);
+            back_buffer_behind = false;
+#endif
+
+#if VID84_COMPRESSION
+            release_video_blocks(cursor);
+#endif
+            frames_held = cursor[1];
+            cursor += 2;
+            data = start_next_frame(&cursor);
+
+#if VID84_TELEMETRY
+            repeat_started = true;
+#endif
+        }
 
-        // We have off time, let's start processing the next frame.
-        if (off_time > 0) {
+        if (frames_held > 0) {
+            // Nothing to draw, the frame on screen just stays up for another frame time.
+            frames_held--;
+            end_of_file = (frames_held == 0 && data == 0xFE);
+            frame_number++;
+
+#if VID84_TELEMETRY
+            telemetry_frame_drawn(cursor);
+            timed = repeat_started;
+#endif
+
+#if VID84_DOUBLE_BUFFER
+            // The back buffer's free, so the next frame can get drawn early and wait
+            // for its deadline there. Only the end of the video has to be waited out.
+            advance_frame_deadline();
+            VID84_FRAME_HOOK(frame_number, cursor);
+            if (end_of_file == true)
+                wait_for_frame_deadline();
+#else
+            advance_frame_deadline();
+            VID84_FRAME_HOOK(frame_number, cursor);
+
+            if (frames_held == 0 && end_of_file == false)
+                process_next_frame(&cursor);
+
+#if VID84_COMPRESSION
+            prefetch_video_block();
+#endif
+
+            wait_for_frame_deadline();
+#endif
+        } else {
+#if VID84_DOUBLE_BUFFER
+
+            // A delta needs the frame on screen underneath it in the back buffer too.
+            const unsigned char* frame = cursor;
+            bool redraw = back_buffer_behind && (int)video_version >= 2 && FRAME_NEEDS_PREVIOUS(*frame);
+
+#if VID84_COMPRESSION
+            // Everything from the oldest frame we're about to read on has to stay decompressed.
+            release_video_blocks(redraw ? shown_frame : frame);
+#endif
+
+            if (redraw)
+                catch_up_back_buffer(shown_frame, frame);
+            shown_frame = frame;
+            back_buffer_behind = true;
+#elif VID84_COMPRESSION
+            release_video_blocks(cursor);
+#endif
+
+            // With double buffering this draws into the back buffer while the
+            // previous frame is still on screen, so there's no need to pre-process
+            // anything during the off-time -- the whole period is ours.
+            data = draw_frame(&cursor);
+
+#if VID84_TELEMETRY
+            telemetry_frame_drawn(cursor);
+#endif
+
+            if (data == 0xFE)
+                end_of_file = true;
+
+            frame_number++;
+
+#if VID84_DOUBLE_BUFFER
+#if VID84_TELEMETRY
+            overrun = frame_deadline_passed();
+#endif
+
+#if VID84_COMPRESSION
+            prefetch_video_block();
+#endif
+
+            // Hold the frame back until its deadline, then show it.
+            wait_for_frame_deadline();
+            show_canvas();
+            advance_frame_deadline();
+            VID84_FRAME_HOOK(frame_number, cursor);
+
+            // The last frame gets its full frame time too, there's nothing after it to wait on.
+            if (end_of_file == true)
+                wait_for_frame_deadline();
+
+#if VID84_FRAME_DROP
             if (end_of_file == false)
-                process_next_frame(&last_data_index, start_time, time_per_frame_ms);
-            // Unless this is the last frame, then just wait.
-            else
-                usleep(off_time * 1000);
+                frame_number += drop_late_frames(&cursor, frame_number);
+#endif
+#else
+            // This frame is up until the next deadline.
+            advance_frame_deadline();
+            VID84_FRAME_HOOK(frame_number, cursor);
+
+#if VID84_TELEMETRY
+            overrun = frame_deadline_passed();
+#endif
+
+#if VID84_FRAME_DROP
+            if (end_of_file == false)
+                frame_number += drop_late_frames(&cursor, frame_number);
+#endif
+
+            // If we have off time, let's start processing the next frame,
+            // unless this is the last one.
+            if (end_of_file == false) {
+#if VID84_TELEMETRY
+                uint32_t prefetch_start = timer_Get(PACING_TIMER);
+                process_next_frame(&cursor);
+                telemetry_frame_prefetched(timer_Get(PACING_TIMER) - prefetch_start);
+#else
+                process_next_frame(&cursor);
+#endif
+            }
+
+#if VID84_COMPRESSION
+            prefetch_video_block();
+#endif
+
+            wait_for_frame_deadline();
+#endif
         }
 
+#if VID84_TELEMETRY
+        if (timed)
+            telemetry_end_frame(overrun);
+#endif
+
         if (end_of_file == true) {
             loop = false;
             break;
         }
     }
+
+#if VID84_CONTROLS
+    end_controls();
+#endif
+
+    end_canvas();
 }
 
 int main(void)
@@ -340,6 +2436,18 @@ int main(void)
     // Init the graphics lib
     gfx_Begin();
 
+    // Nothing to play? Nothing to do.
+    if (!open_video_source()) {
+        gfx_PrintStringXY("== NO VIDEO FOUND ==", 5, 5);
+        gfx_PrintStringXY("Send the video's AppVars over", 5, 15);
+        gfx_PrintStringXY("and try again.", 5, 25);
+        gfx_PrintStringXY("Press any key to exit..", 5, 45);
+
+        while (!os_GetCSC());
+        gfx_End();
+        return -1;
+    }
+
     // Make sure the video is good and store its header vars
     bool valid_vid = retrieve_data_from_video();
 
@@ -358,14 +2466,28 @@ int main(void)
     else {
         gfx_PrintStringXY("== LOADED VIDEO FILE ==", 5, 5);
         gfx_PrintStringXY("Press any key to play! :D", 5, 15);
-        while (!os_GetCSC());
-        gfx_PrintStringXY("Pre-Loading first frame..", 5, 25);
+#if VID84_CONTROLS
+        gfx_PrintStringXY("[2nd] pause, [<] [>] skip, [clear] quit", 5, 35);
+#endif
+        init_frame_timer();
+        init_rectangle_reader();
         init_render_queue();
-        int data_index = prerender_first_frame();
-        begin_decode(data_index);
+
+        // The first frame gets drawn while the prompt's up, a key pressed before
+        // it's done still counts.
+        const unsigned char* cursor;
+        unsigned char data = prerender_first_frame(&cursor);
+
+        while (!os_GetCSC());
+        begin_decode(cursor, data);
     }
 
+#if VID84_TELEMETRY
+    show_telemetry();
+#endif
+
     // Clean up
+    timer_Disable(PACING_TIMER);
     gfx_End();
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,7 @@
 """84VID Video Encoder
 
 This script allows the user to encode OpenCV-compatible video files to
-84VID version 1.0 videos, specifying integer scale, framerate, and
+84VID version 1 or 2 videos, specifying integer scale, framerate, and
 color output thresholds.
 
 See requirements.txt provided with this script for a list of required
@@ -9,10 +9,16 @@ modules.
 """
 
 import argparse
+import collections
+import concurrent.futures
+import io
+import itertools
+import re
 import struct
 import shutil
 import sys
 import os
+import time
 import cv2
 import numpy as np
 from colorama import Fore, Style
@@ -21,19 +27,129 @@ args = {}
 
 TEMP_DIR_PATH = 'temp/'
 MAGIC = '84VID'
-VERS = 1
+VERS = 2
+
+# Version 2 frame types, written after each frame's 0xFF.
+FRAME_TYPE_KEY = 0x00
+FRAME_TYPE_DELTA = 0x01
+FRAME_TYPE_SPANS = 0x02
+FRAME_TYPE_REPEAT = 0x03
+FRAME_TYPE_TILES = 0x04
+
+# Top bits of the frame type for the fields of an interlaced video.
+FRAME_FIELD = 0x80
+FRAME_FIELD_ODD = 0x40
+FRAME_TYPE_MASK = 0x3F
+
+# Tile frames start with a bitmask of the tiles that changed, each
+# this many pixels square before scaling.
+TILE_SIZE = 16
+
+# Holds the frame on screen. Runs of these get merged into one, with
+# a count of how many frame times it covers.
+REPEAT_FRAME = b'\xFF' + bytes([FRAME_TYPE_REPEAT, 1])
+MAX_REPEAT_COUNT = 255
+
+# Delta frames list rectangles to paint black, this marker, then
+# rectangles to paint white.
+DELTA_COLOR_SWITCH = b'\xFD'
+
+# Version 2 header flags.
+FLAG_FRAME_INDEX = 0x01
+FLAG_RECT_SIZE = 0x02
+FLAG_SPAN_FRAMES = 0x04
+FLAG_COMPRESSED = 0x08
+FLAG_PACKED_RECTS = 0x10
+FLAG_TILE_FRAMES = 0x20
+FLAG_INTERLACED = 0x40
+
+# Most frames a second the player takes, or fields for an
+# interlaced video.
+MAX_FPS = 63
+MAX_FIELD_RATE = 2 * MAX_FPS
+
+# Packed rectangle codes, the first byte of each one. The rest is
+# laid out as in the decoder's spec.
+PACKED_SAME_ROW = 0x00          # + gap, then the size in nibbles.
+PACKED_ROWS_DOWN = 0x40         # + rows down - 1, then x and the size in nibbles.
+PACKED_SAME_ROW_LARGE = 0x80    # + gap, then width - 1 and height - 1.
+PACKED_ROWS_DOWN_LARGE = 0xC0   # + rows down, then x, width - 1 and height - 1.
+PACKED_ABSOLUTE = 0xFB          # x, y, width - 1 and height - 1.
+
+# Ends every AppVar of a video but the last one.
+CHUNK_END = b'\xFC'
+
+# Largest AppVar the calculator will hold, and its type ID.
+APPVAR_MAX_SIZE = 65505
+APPVAR_TYPE = 0x15
+
+# ZX7 back-references reach this far, the first 128 of them with a
+# single offset byte.
+ZX7_MAX_OFFSET = 2176
+ZX7_SHORT_OFFSET = 128
+
+# Earlier places with the same two bytes the compressor tries a
+# match from, newest first. More is smaller and slower.
+ZX7_MAX_CANDIDATES = 32
+
+# Rate control simplifies frames in this many steps before it
+# gives up and holds the previous frame.
+RATE_CONTROL_LEVELS = 5
 COL_BLUE = Fore.BLUE
 COL_RED = Fore.RED
 COL_YEL = Fore.YELLOW
 COL_GREEN = Fore.GREEN
 COL_NONE = Style.RESET_ALL
 
+def read_frames_at(indices):
+    '''
+    Grabs just the frames at the given (ascending) frame numbers
+    out of the video, yielding each one. Seeks straight to them
+    when the container lets us, and skips ahead frame by frame
+    otherwise.
+    '''
+    capture = cv2.VideoCapture(args['input_file'])
+    position = 0
+
+    for index in indices:
+        if index != position and capture.set(cv2.CAP_PROP_POS_FRAMES, index):
+            position = index
+
+        # No seeking, grab without decoding until we're there.
+        while position < index and capture.grab():
+            position += 1
+
+        frame_read, frame = capture.read()
+        if position != index or not frame_read:
+            break
+
+        position += 1
+        yield frame
+
+    capture.release()
+
+def get_content_boundaries(frame):
+    '''
+    Returns the XYWH boundaries of everything in the frame that
+    isn't pure black, or None if there's nothing.
+    '''
+    gray = cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY)
+    _,thresh = cv2.threshold(gray, 1, 255, cv2.THRESH_BINARY)
+    points = cv2.findNonZero(thresh)
+
+    if points is None:
+        return None
+
+    return cv2.boundingRect(points)
+
 def get_crop_boundaries_for_image():
     '''
     Returns the XYWH boundaries for cropping OpenCV finds
-    using the frame number provided from -cf.
+    using the frame number provided from -cf, or the union of
+    the ones in the frames sampled with -cs.
     '''
     cf = int(args['crop_frame'])
+    samples = int(args['crop_samples'])
 
     # Report.
     print(f'{COL_BLUE}* {COL_NONE} Calculating boundaries for cropping.')
@@ -42,132 +158,169 @@ def get_crop_boundaries_for_image():
         print(f'{COL_YEL}- {COL_NONE} Cropping disabled. This could result in wasteful meshes.')
         print('   Consider yourself warned!')
         return 0, 0, 0, 0
-    
-    # This is a "little" slow -- but we just open the video and interate
-    # through it like we do in conversion, the reason being is we want
-    # to avoid spamming the disk with writes, which we'd do if we export,
-    # then crop, then re-export. :^)
+
+    # Letterboxing can change over the course of a video, so
+    # sampling all over it catches everything that's ever shown.
     capture = cv2.VideoCapture(args['input_file'])
+    frame_count = int(capture.get(cv2.CAP_PROP_FRAME_COUNT))
+    capture.release()
 
-    i = 0
+    if samples > 0 and frame_count > 0:
+        indices = sorted(set(k * frame_count // samples for k in range(samples)))
+    else:
+        indices = [cf]
 
-    while capture.isOpened():
-        frame_read, frame = capture.read()
+    left, top, right, bottom = None, None, None, None
+    found = 0
+
+    for frame in read_frames_at(indices):
+        found += 1
+        bounds = get_content_boundaries(frame)
 
-        if frame_read:
-            if i == cf:
-                gray = cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY)
-                _,thresh = cv2.threshold(gray, 1, 255, cv2.THRESH_BINARY)
-                cont,hi = cv2.findContours(thresh, cv2.RETR_EXTERNAL, cv2.CHAIN_APPROX_SIMPLE)
-                cnt = cont[0]
-                return cv2.boundingRect(cnt)
-            i += 1
+        if bounds is None:
+            continue
+
+        x, y, w, h = bounds
+        if left is None:
+            left, top, right, bottom = x, y, x + w, y + h
         else:
-            break
+            left, top = min(left, x), min(top, y)
+            right, bottom = max(right, x + w), max(bottom, y + h)
 
     # We never encountered the frame, spew an error.
-    print(f'{COL_RED}Error{COL_NONE}: Could not find crop frame {cf}. Video had {i} frames.')
-    sys.exit()
+    if found == 0:
+        print(f'{COL_RED}Error{COL_NONE}: Could not find crop frame {cf}. Video had {frame_count} frames.')
+        sys.exit()
+
+    # Nothing but black, nothing worth cropping to.
+    if left is None:
+        return 0, 0, 0, 0
 
+    return left, top, right - left, bottom - top
 
-def convert_video_to_image_sequence():
+def open_video_capture():
     '''
-    Uses the input file argument obtained to open the video
-    file and dump its frame contents as .PNG images.
+    Opens the input video file, and settles on the output
+    framerate. Returns the capture and how many of the video's
+    frames go by for each one we keep.
     '''
-    # Remove existing temp directory in case
-    # there was failure before.
-    if os.path.exists(TEMP_DIR_PATH):
-        shutil.rmtree(TEMP_DIR_PATH)
-
-    # Create the directory for temp image output.
-    os.mkdir(TEMP_DIR_PATH)
-
     # Grab the input file.
     capture = cv2.VideoCapture(args['input_file'])
 
     # Make sure target framerate isn't higher than
-    # our video
+    # our video. That goes for fields too, an
+    # interlaced video doesn't split source frames.
     vid_fps = int(capture.get(cv2.CAP_PROP_FPS))
+    fps = int(args['fps'])
 
     # It is, warn and set it to the video's.
     if fps > vid_fps:
         print(f'{COL_YEL}- {COL_NONE} Desired FPS ({fps}) is higher than video ({vid_fps}).')
+        if args['interlace'] and int(args['format_version']) >= 2:
+            print('   Every field is sampled from a frame of its own, so fields can\'t outpace it either.')
         print('   Force-setting to video framerate instead.')
         args['fps'] = vid_fps
+        fps = vid_fps
 
     # Additionally, get the ratio of FPS rate for cutting frames.
-    fps = int(args['fps'])
-    fps_rate = vid_fps / fps
+    return capture, vid_fps / fps
 
+def read_video_frames(capture, fps_rate):
+    '''
+    Decodes the video one frame at a time, and yields every
+    frame we keep, cropped and resized. Only one frame is ever
+    held in memory.
+    '''
     # Retrieve resolution scale
     res = int(240 / int(args['scale_factor']))
 
-    # Report Status
-    print(f'{COL_BLUE}* {COL_NONE} Starting image sequencing.')
-
-    i = 0
     frame_caps = 0
 
     # Image crop boundaries
     crop_x, crop_y, crop_w, crop_h = get_crop_boundaries_for_image()
 
-    # Dump the video as images.
     while capture.isOpened():
         frame_read, frame = capture.read()
 
-        if frame_read:
-            frame_caps = frame_caps + 1
+        if not frame_read:
+            break
 
-            # Check if we should capture this frame.
-            if frame_caps % fps_rate != 0:
-                continue
+        frame_caps = frame_caps + 1
 
-            path = f'{TEMP_DIR_PATH}frame{str(i)}.png'
+        # Check if we should capture this frame.
+        if frame_caps % fps_rate != 0:
+            continue
 
-            if (crop_x != 0 and crop_y != 0) or (crop_w != 0 and crop_h != 0):
-                frame = frame[crop_y:crop_y+crop_h,crop_x:crop_x+crop_w]
+        if (crop_x != 0 and crop_y != 0) or (crop_w != 0 and crop_h != 0):
+            frame = frame[crop_y:crop_y+crop_h,crop_x:crop_x+crop_w]
 
-            # Resize to resolution boundaries and export.
-            frame = cv2.resize(frame, (res, res))
-            cv2.imwrite(path, frame)
-            i += 1
-        else:
-            print(f'{COL_BLUE}* {COL_NONE} Converted video to image sequence.')
-            break
+        # Resize to resolution boundaries.
+        yield cv2.resize(frame, (res, res))
+
+    capture.release()
+
+def convert_video_to_image_sequence(capture, fps_rate):
+    '''
+    Debugging only (--temp-frames): dumps the frames we keep
+    as .PNG images, so they can be looked at. Returns how many
+    there are.
+    '''
+    # Remove existing temp directory in case
+    # there was failure before.
+    if os.path.exists(TEMP_DIR_PATH):
+        shutil.rmtree(TEMP_DIR_PATH)
+
+    # Create the directory for temp image output.
+    os.mkdir(TEMP_DIR_PATH)
+
+    # Report Status
+    print(f'{COL_BLUE}* {COL_NONE} Starting image sequencing.')
+
+    i = 0
+
+    # Dump the video as images.
+    for frame in read_video_frames(capture, fps_rate):
+        cv2.imwrite(f'{TEMP_DIR_PATH}frame{str(i)}.png', frame)
+        i += 1
+
+    print(f'{COL_BLUE}* {COL_NONE} Converted video to image sequence.')
 
     if i == 0:
         print(f'{COL_RED}Error{COL_NONE}: No frames generated, bad video input.')
         sys.exit()
 
-    return i - 1
+    return i
+
+def read_image_sequence(frames):
+    '''
+    Reads back the .PNG images dumped with --temp-frames, one
+    at a time.
+    '''
+    for i in range(frames):
+        path = f'{TEMP_DIR_PATH}/frame{str(i)}.png'
+
+        # End if we're out of frames to process.
+        if not os.path.isfile(path):
+            print(f'{COL_RED}Error{COL_NONE}: Could not find frame {str(i)}.')
+            break
+
+        yield cv2.imread(path)
 
 def image_to_array(image):
     '''
-    Takes in an OpenCV image and converts it into a 2D Array
-    whose contents are either '1' (for a black pixel) or '0'
-    (for a while pixel) at coordinates [X][Y].
+    Takes in an OpenCV image and converts it into a 2D boolean
+    numpy array, True for a black pixel and False for a white
+    one, indexed [Y][X].
     '''
     # Retrieve resolution scale
     res = int(240 / int(args['scale_factor']))
 
-    # Start with all black pixels
-    array = [[1 for i in range(res)] for j in range(res)]
-
     # Retrieve color threshold
     col = int(args['color_threshold'])
 
-    for x_coord in range(res):
-        for y_coord in range(res):
-            # Get the RGB color values
-            col_r, col_g, col_b = (image[x_coord, y_coord])
-
-            # If a value is above the treshold, this
-            # is a filled pixel in our format.
-            if col_r >= col or col_g >= col or col_b >= col:
-                array[x_coord][y_coord] = 0
-
-    return array
+    # If any of the color values is above the threshold, this
+    # is a filled pixel in our format.
+    return image[:res, :res].max(axis=2) < col
 
 def greedy_mesh_frame(array):
     '''
@@ -176,121 +329,1108 @@ def greedy_mesh_frame(array):
     turned into rectangles using Greedy Meshing. Returns a 
     list of rectangle vertices.
     '''
-    height = len(array)
-    width = len(array[0])
+    black = np.asarray(array, dtype=bool)
+    height, width = black.shape
     visited = np.zeros((height, width), dtype=bool)
     rectangles = []
 
-    # Walk through the possible-rectangle to confirm
-    # regions are valid.
-    def is_valid_rectangle(top, left, bottom, right):
-        for i in range(left, right + 1):
-            for j in range(top, bottom + 1):
-                if array[i][j] == 0 or visited[i][j]:
-                    return False
-        return True
-
-    # Start expanding and exploring a region of the
-    # frame array.
-    def explore_rectangle(top, left):
-        bottom = top
-        while bottom < height and array[bottom][left] == 1 and not visited[bottom][left]:
-            right = left
-            while right < width and array[bottom][right] == 1 and not visited[bottom][right]:
-                visited[bottom][right] = True
-                right += 1
-            bottom += 1
-            if not is_valid_rectangle(top, left, bottom - 1, right - 1):
-                break
-        rectangles.append((left, top, right - 1, bottom - 1))
+    # How many black pixels there are straight down from each
+    # pixel, counting itself. There's an extra row of zeroes at
+    # the bottom to build up from.
+    run_down = np.zeros((height + 1, width + 1), dtype=np.int32)
+    for i in range(height - 1, -1, -1):
+        run_down[i, :width] = (run_down[i + 1, :width] + 1) * black[i]
 
-    # Walk through the 2D array to find pixels
-    # to try and create rectangles from.
-    for i in range(height):
-        for j in range(width):
-            if array[i][j] == 1 and not visited[i][j]:
-                explore_rectangle(i, j)
+    # Rectangles start from each run of black pixels that no
+    # rectangle covers yet, going left to right and top to
+    # bottom. The first row decides the width, and the rectangle
+    # grows down for as long as the full width of the next row
+    # is still black. A rectangle from further up can't be in
+    # the way there: it would have had to cover this row too.
+    for top in range(height):
+        row = (black[top] & ~visited[top]).astype(np.int8)
+        edges = np.flatnonzero(np.diff(np.concatenate(([0], row, [0]))))
+        if len(edges) == 0:
+            continue
+
+        lefts = edges[0::2].tolist()
+        rights = edges[1::2].tolist()
+        sizes = np.minimum.reduceat(run_down[top], edges)[0::2].tolist()
+
+        for left, right, size in zip(lefts, rights, sizes):
+            visited[top:top + size, left:right] = True
+            rectangles.append((left, top, right - 1, top + size - 1))
 
     return rectangles
 
-def push_rectangle_to_file(rect, outfile):
+def maximal_mesh_frame(array, allowed):
+    '''
+    A slower alternative to greedy_mesh_frame that usually takes
+    fewer rectangles. Each one still starts from the first pixel
+    no rectangle covers yet, but takes whichever width covers the
+    most of what's left, and can run over pixels that are already
+    covered or that are in allowed. Rectangles that end up
+    entirely under others are dropped. Returns a list of
+    rectangle vertices.
+    '''
+    left_over = np.array(array, dtype=bool)
+    allowed = np.asarray(allowed, dtype=bool) | left_over
+    height, width = left_over.shape
+    rectangles = []
+
+    # Same as in greedy_mesh_frame, but for everywhere allowed.
+    run_down = np.zeros((height + 1, width), dtype=np.int32)
+    for i in range(height - 1, -1, -1):
+        run_down[i] = (run_down[i + 1] + 1) * allowed[i]
+
+    for top in range(height):
+        for left in np.flatnonzero(left_over[top]).tolist():
+            # A rectangle from further left on this row may have
+            # taken it already.
+            if not left_over[top, left]:
+                continue
+
+            # Every width as far as the row is allowed to go, each
+            # as tall as it can be, and how much of what's left it
+            # takes in. The narrowest that takes in the most wins.
+            blocked = np.flatnonzero(~allowed[top, left:])
+            end = left + int(blocked[0]) if len(blocked) > 0 else width
+
+            heights = np.minimum.accumulate(run_down[top, left:end])
+            columns = np.cumsum(left_over[top:top + int(heights[0]), left:end], axis=0)
+            gains = np.cumsum(columns, axis=1)[heights - 1, np.arange(end - left)]
+
+            right = left + int(np.argmax(gains)) + 1
+            bottom = top + int(heights[right - left - 1])
+
+            # Nothing's gained from rows at the bottom with nothing
+            # left in them.
+            rows = np.flatnonzero(left_over[top:bottom, left:right].any(axis=1))
+            bottom = top + int(rows[-1]) + 1
+
+            # Reaching further left can take in some of what's left
+            # on the rows below.
+            start = left
+            while start > 0 and run_down[top, start - 1] >= bottom - top:
+                start -= 1
+            reached = np.flatnonzero(left_over[top:bottom, start:left].any(axis=0))
+            start = start + int(reached[0]) if len(reached) > 0 else left
+
+            left_over[top:bottom, start:right] = False
+            rectangles.append((start, top, right - 1, bottom - 1))
+
+    return drop_covered_rectangles(rectangles, array)
+
+def drop_covered_rectangles(rects, array):
+    '''
+    Drops rectangles whose black pixels from array are all
+    covered by other rectangles too, smallest first. Returns
+    the rest left to right and top to bottom.
+    '''
+    needed = np.asarray(array, dtype=bool)
+    coverage = np.zeros(needed.shape, dtype=np.int32)
+    for left, top, right, bottom in rects:
+        coverage[top:bottom + 1, left:right + 1] += 1
+
+    kept = []
+    for rect in sorted(rects, key=lambda r: (r[2] - r[0] + 1) * (r[3] - r[1] + 1)):
+        left, top, right, bottom = rect
+        window = (slice(top, bottom + 1), slice(left, right + 1))
+
+        if ((coverage[window] >= 2) | ~needed[window]).all():
+            coverage[window] -= 1
+        else:
+            kept.append(rect)
+
+    return sorted(kept, key=lambda r: (r[1], r[0]))
+
+def mesh_cost(rects):
+    '''
+    Estimates how long the player takes to fill a list of
+    rectangle vertices, in microseconds, with the same model as
+    frame_draw_cost.
+    '''
+    scale = int(args['scale_factor'])
+    pixels = sum((r[2] - r[0] + 1) * (r[3] - r[1] + 1) for r in rects) * scale * scale
+
+    return len(rects) * float(args['cost_per_fill']) + pixels * float(args['cost_per_pixel'])
+
+def mesh_frame(array, allowed=None):
+    '''
+    Meshes the black pixels of a 2D array into a list of
+    rectangle vertices. With --optimize-mesh, this tries both
+    greedy_mesh_frame and maximal_mesh_frame, going along rows
+    and down columns, and keeps whichever mesh the player draws
+    the quickest. allowed is where else rectangles can run over
+    without changing what ends up on screen, if anywhere.
+    '''
+    if not args['optimize_mesh']:
+        return greedy_mesh_frame(array)
+
+    array = np.asarray(array, dtype=bool)
+    allowed = array if allowed is None else np.asarray(allowed, dtype=bool)
+
+    meshes = [greedy_mesh_frame(array), maximal_mesh_frame(array, allowed)]
+
+    # Down columns is along rows on the frame turned on its side.
+    for rects in (greedy_mesh_frame(array.T), maximal_mesh_frame(array.T, allowed.T)):
+        meshes.append(sorted([(top, left, bottom, right) for left, top, right, bottom in rects],
+        key=lambda r: (r[1], r[0])))
+
+    # The first one, plain greedy meshing, wins ties.
+    return min(meshes, key=mesh_cost)
+
+def span_encode_frame(array):
+    '''
+    Takes in a 2D Array of pixel contents and finds the runs of
+    black pixels on each row. Returns a list of (y, runs) for
+    every row that has any, runs being a list of (x, length).
+    '''
+    rows = []
+
+    for y, row in enumerate(np.asarray(array, dtype=np.int8)):
+        # A run starts where a row goes from 0 to 1, and ends
+        # where it goes back.
+        edges = np.flatnonzero(np.diff(np.concatenate(([0], row, [0]))))
+        if len(edges) == 0:
+            continue
+
+        starts = edges[0::2]
+        lengths = edges[1::2] - starts
+        rows.append((y, list(zip(starts.tolist(), lengths.tolist()))))
+
+    return rows
+
+def span_frame_size(rows):
+    '''
+    Number of bytes a span frame takes up, not counting the
+    frame marker and type.
+    '''
+    return sum(2 + 2 * len(runs) for _, runs in rows)
+
+def push_span_rows_to_file(rows, outfile):
+    '''
+    Writes the rows of a span frame: the row, the number of runs
+    on it, then each run's X coordinate and length minus one.
+    '''
+    for y, runs in rows:
+        outfile.write(bytes([y, len(runs)] + [v for x, length in runs for v in (x, length - 1)]))
+
+def push_rectangle_to_file(rect, outfile, sizes=False):
     '''
     Helper method to cleanly take rectangle vertices, convert
     them to bytes, and push them to the provided encoded file.
+    With sizes, the far corner is written as a width and height
+    instead.
+    '''
+    if sizes:
+        rect = (rect[0], rect[1], rect[2] - rect[0] + 1, rect[3] - rect[1] + 1)
+
+    outfile.write(bytes(rect))
+
+def pack_rectangles(rects):
+    '''
+    Packs a list of rectangle vertices, each one stored relative
+    to the one before it. Meshes go left to right and top to
+    bottom, so the next rectangle is usually a short way along
+    the same row or a few rows down, and most are small enough
+    for their size to fit in a byte.
+    '''
+    packed = bytearray()
+    y, right = 0, 0
+
+    for rect in rects:
+        width = rect[2] - rect[0] + 1
+        height = rect[3] - rect[1] + 1
+        gap = rect[0] - right
+        down = rect[1] - y
+        small = width <= 16 and height <= 16
+        size = ((width - 1) << 4) | (height - 1)
+
+        if down == 0 and 0 <= gap < 64:
+            if small:
+                packed += bytes([PACKED_SAME_ROW + gap, size])
+            else:
+                packed += bytes([PACKED_SAME_ROW_LARGE + gap, width - 1, height - 1])
+        elif small and 1 <= down <= 64:
+            packed += bytes([PACKED_ROWS_DOWN + down - 1, rect[0], size])
+        elif 0 <= down < PACKED_ABSOLUTE - PACKED_ROWS_DOWN_LARGE:
+            packed += bytes([PACKED_ROWS_DOWN_LARGE + down, rect[0], width - 1, height - 1])
+        else:
+            packed += bytes([PACKED_ABSOLUTE, rect[0], rect[1], width - 1, height - 1])
+
+        y, right = rect[1], rect[0] + width
+
+    return bytes(packed)
+
+def unpack_rectangle_sizes(data, i):
+    '''
+    Reads the widths and heights back out of the packed
+    rectangles starting at i. Returns them, and where the
+    marker they end at is.
+    '''
+    widths, heights = [], []
+
+    while i < len(data) and data[i] < CHUNK_END[0]:
+        code = data[i]
+
+        if code < PACKED_ROWS_DOWN:
+            size = data[i + 1]
+            i += 2
+        elif code < PACKED_SAME_ROW_LARGE:
+            size = data[i + 2]
+            i += 3
+        else:
+            if code < PACKED_ROWS_DOWN_LARGE:
+                i += 1
+            elif code < PACKED_ABSOLUTE:
+                i += 2
+            else:
+                i += 3
+
+            widths.append(data[i] + 1)
+            heights.append(data[i + 1] + 1)
+            i += 2
+            continue
+
+        widths.append((size >> 4) + 1)
+        heights.append((size & 0x0F) + 1)
+
+    return widths, heights, i
+
+def encode_rectangles(rects):
+    '''
+    Turns a list of rectangle vertices into bytes, laid out the
+    way the command line asked for.
+    '''
+    if int(args['format_version']) >= 2 and args['packed_rects']:
+        return pack_rectangles(rects)
+
+    output = io.BytesIO()
+    for rectangle in rects:
+        push_rectangle_to_file(rectangle, output, int(args['format_version']) >= 2 and args['rect_size'])
+    return output.getvalue()
+
+def delta_mesh_frame(array, last_array):
+    '''
+    Compares a 2D Array of pixel contents against the one
+    from the previous frame and returns two lists of rectangle
+    vertices: pixels that turned black, and pixels that turned
+    white.
+    '''
+    current = np.asarray(array, dtype=bool)
+    previous = np.asarray(last_array, dtype=bool)
+
+    to_black = current & ~previous
+    to_white = previous & ~current
+
+    # Painting black over what's black already is harmless, and so
+    # is painting over what the white rectangles repaint after.
+    return mesh_frame(to_black, current | previous), mesh_frame(to_white, ~current)
+
+def tile_fills(tiles):
+    '''
+    How the player clears the changed tiles from a 2D array of
+    them: one fill for every run of them along a row. Returns the
+    number of fills, and the pixels they cover before scaling.
+    '''
+    res = 240 // int(args['scale_factor'])
+    sizes = np.minimum(TILE_SIZE, res - TILE_SIZE * np.arange(tiles.shape[0]))
+
+    padded = np.pad(tiles.astype(np.int8), ((0, 0), (1, 0)))
+    fills = int((np.diff(padded, axis=1) == 1).sum())
+    pixels = int((sizes[:, None] * sizes[None, :] * tiles).sum())
+
+    return fills, pixels
+
+def tile_mesh_frame(array, last_array):
+    '''
+    Finds the tiles that changed since the previous frame, and
+    meshes what's black inside them. Returns the tile bitmask, a
+    2D array of which tiles changed, and the list of rectangle
+    vertices.
+    '''
+    current = np.asarray(array, dtype=bool)
+    changed = current != np.asarray(last_array, dtype=bool)
+
+    # Pad out to whole tiles, then see which have anything in them.
+    res = current.shape[0]
+    across = (res + TILE_SIZE - 1) // TILE_SIZE
+    padded = np.zeros((across * TILE_SIZE, across * TILE_SIZE), dtype=bool)
+    padded[:res, :res] = changed
+    tiles = padded.reshape(across, TILE_SIZE, across, TILE_SIZE).any(axis=(1, 3))
+
+    # Rectangles can't reach outside the tiles that get cleared.
+    inside = np.repeat(np.repeat(tiles, TILE_SIZE, axis=0), TILE_SIZE, axis=1)[:res, :res]
+    mask = np.packbits(tiles.flatten(), bitorder='little').tobytes()
+
+    # Outside them, what's on screen is black wherever this ends up
+    # black too.
+    return mask, tiles, mesh_frame(current & inside, current)
+
+def write_frame(output, frame_array, last_array, force_key, field=None):
+    '''
+    Meshes a frame and writes it to the encoded file. For
+    version 2 files this picks between a keyframe, a delta
+    against the previous frame and a tile frame, whichever is
+    the fewest fills. If that still comes out bigger than
+    storing the frame as row spans, it's written as a span
+    frame instead. With a field (see frame_field), only its
+    rows go in, and never as a tile frame.
+    '''
+    # Frames always begin with the new frame identifier.
+    output.write(b'\xFF')
+
+    field_bits = 0
+    if field is not None:
+        # The player spreads the rows back out.
+        frame_array = np.asarray(frame_array, dtype=bool)[field::2]
+        last_array = np.asarray(last_array, dtype=bool)[field::2]
+        field_bits = FRAME_FIELD | (FRAME_FIELD_ODD if field else 0)
+
+    key_frame = mesh_frame(frame_array)
+
+    if int(args['format_version']) == 1:
+        output.write(encode_rectangles(key_frame))
+        return
+
+    frame_type = FRAME_TYPE_KEY
+    mesh = encode_rectangles(key_frame)
+    fills = len(key_frame)
+
+    if not force_key and last_array is not None:
+        to_black, to_white = delta_mesh_frame(frame_array, last_array)
+
+        # The color switch marker costs about as much as a
+        # rectangle, so count it as one.
+        if len(to_black) + len(to_white) + 1 < fills:
+            frame_type = FRAME_TYPE_DELTA
+            mesh = encode_rectangles(to_black) + DELTA_COLOR_SWITCH + encode_rectangles(to_white)
+            fills = len(to_black) + len(to_white) + 1
+
+        if args['tile_frames'] and field is None:
+            mask, tiles, rects = tile_mesh_frame(frame_array, last_array)
+            clears, _ = tile_fills(tiles)
+
+            if clears + len(rects) < fills:
+                frame_type = FRAME_TYPE_TILES
+                mesh = mask + encode_rectangles(rects)
+                fills = clears + len(rects)
+
+    if args['span_frames']:
+        rows = span_encode_frame(frame_array)
+        if span_frame_size(rows) < len(mesh):
+            output.write(bytes([FRAME_TYPE_SPANS | field_bits]))
+            push_span_rows_to_file(rows, output)
+            return
+
+    output.write(bytes([frame_type | field_bits]))
+    output.write(mesh)
+
+def write_frame_index(output, frame_offsets):
+    '''
+    Writes the frame index trailer: the offset of every frame's
+    0xFF, followed by the frame count, all 24-bit little endian.
+    There's an entry for every frame time, so a repeat frame's
+    offset shows up once for each one it covers.
+    '''
+    for offset in frame_offsets:
+        output.write(offset.to_bytes(3, byteorder='little'))
+    output.write(len(frame_offsets).to_bytes(3, byteorder='little'))
+
+class Zx7Writer:
+    '''
+    ZX7 interleaves its control bits with whole bytes. Bits fill a
+    byte from the top, and that byte sits in the output where the
+    first of its bits was written, which is where the decompressor
+    goes to read it.
+    '''
+    def __init__(self):
+        self.output = bytearray()
+        self.bit_mask = 0
+        self.bit_index = 0
+
+    def write_byte(self, value):
+        self.output.append(value)
+
+    def write_bit(self, value):
+        if self.bit_mask == 0:
+            self.bit_mask = 128
+            self.bit_index = len(self.output)
+            self.output.append(0)
+        if value:
+            self.output[self.bit_index] |= self.bit_mask
+        self.bit_mask >>= 1
+
+    def write_elias_gamma(self, value):
+        # A zero for every bit past the first, then all of its bits.
+        for _ in range(value.bit_length() - 1):
+            self.write_bit(0)
+        for bit in range(value.bit_length() - 1, -1, -1):
+            self.write_bit((value >> bit) & 1)
+
+def zx7_match_bits(length, offset):
+    '''
+    Bits a ZX7 back-reference takes up: its flag, Elias gamma
+    length, and one offset byte plus four more bits past 128.
+    '''
+    return 1 + 2 * (length - 1).bit_length() - 1 + (8 if offset <= ZX7_SHORT_OFFSET else 12)
+
+def zx7_longest_match(data, position, chains):
+    '''
+    Finds the longest earlier copy of what's at position, among
+    the last few places its first two bytes showed up. Returns
+    (length, offset), or (0, 0) if there's nothing worth taking.
+    '''
+    best_length = 0
+    best_offset = 0
+    limit = len(data) - position
+
+    for start in reversed(chains.get(data[position:position + 2], [])[-ZX7_MAX_CANDIDATES:]):
+        offset = position - start
+        if offset > ZX7_MAX_OFFSET:
+            break
+
+        length = 2
+        while length < limit and data[start + length] == data[position + length]:
+            length += 1
+
+        if length > best_length:
+            best_length = length
+            best_offset = offset
+            if length == limit:
+                break
+
+    # It has to come out smaller than the literals it replaces.
+    if best_length < 2 or zx7_match_bits(best_length, best_offset) >= best_length * 9:
+        return (0, 0)
+    return (best_length, best_offset)
+
+def zx7_compress(data):
+    '''
+    Compresses data into the ZX7 format the CE toolchain's
+    zx7_Decompress reads. Matches are picked greedily, only held
+    off when the next byte starts a longer one.
+    '''
+    writer = Zx7Writer()
+    chains = {}
+
+    def remember(position):
+        chains.setdefault(data[position:position + 2], []).append(position)
+
+    # The first byte is always a literal, without a flag.
+    writer.write_byte(data[0])
+    remember(0)
+
+    position = 1
+    while position < len(data):
+        length, offset = zx7_longest_match(data, position, chains)
+
+        if length > 0 and position + 1 < len(data):
+            next_length, _ = zx7_longest_match(data, position + 1, chains)
+            if next_length > length:
+                length = 0
+
+        if length == 0:
+            writer.write_bit(0)
+            writer.write_byte(data[position])
+            remember(position)
+            position += 1
+            continue
+
+        writer.write_bit(1)
+        writer.write_elias_gamma(length - 1)
+        offset -= 1
+        if offset < ZX7_SHORT_OFFSET:
+            writer.write_byte(offset)
+        else:
+            offset -= ZX7_SHORT_OFFSET
+            writer.write_byte((offset & 127) | 128)
+            for bit in range(10, 6, -1):
+                writer.write_bit((offset >> bit) & 1)
+
+        for i in range(position, position + length):
+            remember(i)
+        position += length
+
+    # End marker, a back-reference with a length too long to be real.
+    writer.write_bit(1)
+    for _ in range(16):
+        writer.write_bit(0)
+    writer.write_bit(1)
+
+    return bytes(writer.output)
+
+def write_compressed_block(output, block):
+    '''
+    Writes one block of whole frames (ending in its 0xFC or the
+    0xFE end code) compressed, after its sizes. Returns how big
+    it came out.
+    '''
+    if len(block) > 0xFFFF:
+        print(f'{COL_RED}Error{COL_NONE}: A frame is too big to compress, try without -z.')
+        sys.exit()
+
+    packed = zx7_compress(block)
+    output.write(struct.pack('<HH', len(block), len(packed)))
+    output.write(packed)
+    return len(packed)
+
+def frame_draw_cost(frame_data):
+    '''
+    Estimates how long the player takes to draw an encoded
+    frame, in microseconds, using the cost model from the
+    command line: a fixed cost per frame, plus a cost per fill
+    and per pixel filled, after scaling. Frames that build on
+    the one before also pay for getting it into the back buffer,
+    which is at most a copy.
+    '''
+    scale = int(args['scale_factor'])
+    version = int(args['format_version'])
+
+    # Every frame but a delta starts by clearing the canvas.
+    fills = 1
+    pixels = 240 * 240
+    frame_type = FRAME_TYPE_KEY
+    data = frame_data[1:]
+    copy = 0
+
+    if version >= 2:
+        frame_type = data[0] & FRAME_TYPE_MASK
+        if data[0] & FRAME_FIELD:
+            pixels //= 2
+        if frame_type in (FRAME_TYPE_DELTA, FRAME_TYPE_TILES) or data[0] & FRAME_FIELD:
+            copy = float(args['cost_per_copy'])
+        data = data[1:]
+        if frame_type == FRAME_TYPE_DELTA:
+            fills = 0
+            pixels = 0
+        elif frame_type == FRAME_TYPE_TILES:
+            across = (240 // scale + TILE_SIZE - 1) // TILE_SIZE
+            mask_length = (across * across + 7) // 8
+            tiles = np.unpackbits(np.frombuffer(data[:mask_length], dtype=np.uint8), bitorder='little')
+            fills, pixels = tile_fills(tiles[:across * across].reshape(across, across).astype(bool))
+            pixels *= scale * scale
+            data = data[mask_length:]
+
+    if frame_type == FRAME_TYPE_SPANS:
+        i = 0
+        while i < len(data):
+            runs = data[i + 1]
+            lengths = np.frombuffer(data, dtype=np.uint8, count=runs * 2, offset=i + 2)[1::2]
+            fills += runs
+            pixels += (int(lengths.sum()) + runs) * scale * scale
+            i += 2 + runs * 2
+    elif version >= 2 and args['packed_rects']:
+        # Packed rectangles can have anything past their first
+        # byte, so they're read one at a time.
+        i = 0
+        while i < len(data):
+            widths, heights, i = unpack_rectangle_sizes(data, i)
+            fills += len(widths)
+            pixels += sum(w * h for w, h in zip(widths, heights)) * scale * scale
+            i += 1 # Past the color switch.
+    else:
+        # Coordinates never reach 0xFD, so the color switch is
+        # the only thing that isn't a rectangle.
+        rects = np.frombuffer(data.replace(DELTA_COLOR_SWITCH, b''), dtype=np.uint8)
+        rects = rects.reshape(-1, 4).astype(np.int32)
+
+        if version == 1:
+            widths = np.maximum(np.abs(rects[:, 2] - rects[:, 0]), 1)
+            heights = np.maximum(np.abs(rects[:, 3] - rects[:, 1]), 1)
+        elif args['rect_size']:
+            widths, heights = rects[:, 2], rects[:, 3]
+        else:
+            widths = rects[:, 2] - rects[:, 0] + 1
+            heights = rects[:, 3] - rects[:, 1] + 1
+
+        fills += len(rects)
+        pixels += int((widths * heights).sum()) * scale * scale
+
+    return (float(args['cost_per_frame']) + copy + fills * float(args['cost_per_fill']) +
+    pixels * float(args['cost_per_pixel']))
+
+def simplify_frame(array, level):
+    '''
+    Returns a simpler version of a frame for rate control, with
+    fewer, bigger shapes the higher the level goes. The first
+    levels smooth away lone pixels and dithering, the rest drop
+    the frame down to a coarser grid.
+    '''
+    pixels = np.asarray(array, dtype=np.uint8) * 255
+    height, width = pixels.shape
+
+    if level <= 2:
+        return cv2.medianBlur(pixels, 2 * level + 1) > 127
+
+    block = 2 ** (level - 2)
+    coarse = cv2.resize(pixels, (max(width // block, 1), max(height // block, 1)),
+    interpolation=cv2.INTER_AREA)
+    return cv2.resize(coarse, (width, height), interpolation=cv2.INTER_NEAREST) > 127
+
+def frame_field(i, keyframe_interval):
+    '''
+    Which rows frame i of an interlaced video carries: 0 for the
+    even ones, 1 for the odd, or None for all of them. The first
+    frame and forced keyframes are always whole, so there's
+    somewhere to start from.
+    '''
+    if not args['interlace'] or int(args['format_version']) < 2 or i == 0:
+        return None
+    if keyframe_interval > 0 and i % keyframe_interval == 0:
+        return None
+    return i % 2
+
+def shown_after(frame_array, last_array, field):
+    '''
+    What the player has on screen after frame_array goes in,
+    with last_array on screen before it. That's just the frame,
+    unless it's a field, which only replaces its own rows.
+    '''
+    if field is None:
+        return frame_array
+
+    shown = np.array(last_array, dtype=bool)
+    shown[field::2] = np.asarray(frame_array, dtype=bool)[field::2]
+    return shown
+
+def encode_frame(frame_array, last_array, force_key, field=None):
+    '''
+    Meshes and encodes a single frame. last_array is the frame
+    the player will have on screen before this one, and field
+    which rows go in (see frame_field). Returns the frame's
+    bytes, the frame as the player will actually show it, and
+    how far rate control had to simplify it (0 for not at all).
+    '''
+    shown_array = shown_after(frame_array, last_array, field)
+
+    # Nothing changed, so the player has nothing to draw either.
+    # Forced keyframes still go in, so there's somewhere to resume
+    # from in a long static shot.
+    if (int(args['format_version']) >= 2 and last_array is not None and not force_key and
+    np.array_equal(shown_array, last_array)):
+        return REPEAT_FRAME, last_array, 0
+
+    frame_data = io.BytesIO()
+    write_frame(frame_data, frame_array, last_array, force_key, field)
+
+    if not args['rate_control']:
+        return frame_data.getvalue(), shown_array, 0
+
+    budget = 1000000 / int(args['fps'])
+    if frame_draw_cost(frame_data.getvalue()) <= budget:
+        return frame_data.getvalue(), shown_array, 0
+
+    for level in range(1, RATE_CONTROL_LEVELS + 1):
+        simple_array = simplify_frame(frame_array, level)
+
+        frame_data = io.BytesIO()
+        write_frame(frame_data, simple_array, last_array, force_key, field)
+        if frame_draw_cost(frame_data.getvalue()) <= budget:
+            return frame_data.getvalue(), shown_after(simple_array, last_array, field), level
+
+    # Still too much, leave what's on screen be. This can cost us a
+    # forced keyframe, which just means the next one comes later.
+    if int(args['format_version']) >= 2 and last_array is not None:
+        return REPEAT_FRAME, last_array, RATE_CONTROL_LEVELS + 1
+
+    # Version 1 has no repeats, so the frame on screen goes in again.
+    # It made it in time before, so it still does.
+    if last_array is not None:
+        frame_data = io.BytesIO()
+        write_frame(frame_data, last_array, None, force_key)
+        return frame_data.getvalue(), last_array, RATE_CONTROL_LEVELS + 1
+
+    # The first frame has nothing to hold on to, all we can afford is
+    # a blank frame.
+    blank_array = np.zeros_like(np.asarray(frame_array, dtype=bool))
+    frame_data = io.BytesIO()
+    write_frame(frame_data, blank_array, last_array, force_key)
+    return frame_data.getvalue(), blank_array, RATE_CONTROL_LEVELS + 1
+
+def encode_frames(images, keyframe_interval):
+    '''
+    Thresholds, meshes and encodes each frame from images in
+    turn, yielding the bytes of every frame and how far rate
+    control simplified it.
+    '''
+    last_array = None
+
+    for i, image_frame in enumerate(images):
+        # Turn the image into a 2D array
+        frame_array = image_to_array(image_frame)
+
+        # Now mesh it and push 'em!
+        force_key = keyframe_interval > 0 and i % keyframe_interval == 0
+        field = frame_field(i, keyframe_interval)
+        frame_data, last_array, level = encode_frame(frame_array, last_array, force_key, field)
+        yield frame_data, level
+
+def init_encode_worker(parent_args):
+    '''
+    Hands the command line arguments to a --jobs worker, which
+    doesn't necessarily start out with a copy of ours.
     '''
-    rect_x = rect[0].to_bytes(1, byteorder='big')
-    rect_y = rect[1].to_bytes(1, byteorder='big')
-    rect_x2 = rect[2].to_bytes(1, byteorder='big')
-    rect_y2 = rect[3].to_bytes(1, byteorder='big')
+    global args
+    args = parent_args
+
+def encode_frame_job(job):
+    '''
+    The work a --jobs worker does for a single frame. Gets what
+    encode_frame does, and returns what it does.
+    '''
+    return encode_frame(*job)
+
+def encode_frames_in_parallel(images, keyframe_interval, jobs):
+    '''
+    Same as encode_frames, but spreads the frames out over a pool
+    of worker processes. Frames still come out in order, and only
+    a couple per worker are ever in flight at once so memory
+    doesn't grow with the length of the video.
+    '''
+    # Workers take it that the frames before theirs were shown as is.
+    # When rate control changed what was on screen, the frame is redone
+    # here against what really was, same as encode_frames would have.
+    last_array = None
+
+    def finish_frame(job, frame_array, assumed_array, force_key, field):
+        nonlocal last_array
+        frame_data, shown_array, level = job.result()
+
+        if last_array is not None and not np.array_equal(assumed_array, last_array):
+            frame_data, shown_array, level = encode_frame(frame_array, last_array, force_key, field)
+
+        last_array = shown_array
+        return frame_data, level
+
+    with concurrent.futures.ProcessPoolExecutor(max_workers=jobs, initializer=init_encode_worker,
+    initargs=(args,)) as pool:
+        pending = collections.deque()
+        assumed_array = None
+
+        for i, image_frame in enumerate(images):
+            frame_array = image_to_array(image_frame)
+            force_key = keyframe_interval > 0 and i % keyframe_interval == 0
+            field = frame_field(i, keyframe_interval)
+
+            job = pool.submit(encode_frame_job, (frame_array, assumed_array, force_key, field))
+            pending.append((job, frame_array, assumed_array, force_key, field))
+            assumed_array = shown_after(frame_array, assumed_array, field)
+
+            # Hold off on decoding more until the oldest frame is written.
+            if len(pending) >= jobs * 2:
+                yield finish_frame(*pending.popleft())
+
+        while pending:
+            yield finish_frame(*pending.popleft())
+
+def merge_repeated_frames(encoded_frames):
+    '''
+    Folds runs of repeat frames from encode_frames into one,
+    up to as many frame times as its count goes. Yields the
+    bytes of every frame, and the rate control level of each
+    frame time it covers.
+    '''
+    repeats = []
+
+    for frame_data, level in encoded_frames:
+        if frame_data == REPEAT_FRAME:
+            repeats.append(level)
+            if len(repeats) < MAX_REPEAT_COUNT:
+                continue
+        elif len(repeats) == 0:
+            yield frame_data, [level]
+            continue
+
+        yield REPEAT_FRAME[:2] + bytes([len(repeats)]), repeats
+        repeats = []
+
+        if frame_data != REPEAT_FRAME:
+            yield frame_data, [level]
 
-    outfile.write(rect_x)
-    outfile.write(rect_y)
-    outfile.write(rect_x2)
-    outfile.write(rect_y2)
+    if len(repeats) > 0:
+        yield REPEAT_FRAME[:2] + bytes([len(repeats)]), repeats
 
-def encode_images_to_84vid(frames):
+def write_reference_frames(images, path, keyframe_interval):
     '''
-    Creates the encoded file, and walks through all of our
-    .PNG frames to go through multiple conversion steps and
-    properly write the contents into said file.
+    Passes images on through, writing each one to path as the
+    player should end up showing it, for decoder/host's bench -r
+    to check against: 240x240 bytes per frame, 0 for black and
+    255 for white. Fields of an interlaced video only change
+    their own rows.
     '''
-    with open(args['output_file'], 'wb') as output:
+    scale = int(args['scale_factor'])
+    shown = None
+
+    with open(path, 'wb') as reference:
+        for i, image in enumerate(images):
+            shown = shown_after(image_to_array(image), shown, frame_field(i, keyframe_interval))
+            black = np.repeat(np.repeat(shown, scale, axis=0), scale, axis=1)
+            frame = np.full((240, 240), 255, dtype=np.uint8)
+            frame[:black.shape[0], :black.shape[1]][black] = 0
+            reference.write(frame.tobytes())
+            yield image
+
+def encode_images_to_84vid(images, frames):
+    '''
+    Encodes the video in memory, walking through the frames from
+    images one at a time to go through multiple conversion steps.
+    frames is about how many there will be, for status reports.
+    Returns the encoded video, and where its frames start (or its
+    blocks, for a compressed video).
+    '''
+    version = int(args['format_version'])
+
+    # Make sure there's anything to encode before making a file.
+    images = iter(images)
+    first_image = next(images, None)
+
+    if first_image is None:
+        print(f'{COL_RED}Error{COL_NONE}: No frames generated, bad video input.')
+        sys.exit()
+
+    images = itertools.chain([first_image], images)
+
+    # Forced keyframes are how often (in frames) the decoder
+    # is allowed to start from scratch.
+    keyframe_interval = int(float(args['keyframe_interval']) * int(args['fps']))
+
+    if args['reference_frames'] is not None:
+        images = write_reference_frames(images, args['reference_frames'], keyframe_interval)
+
+    compress = version >= 2 and args['compress']
+    block_size = int(args['block_size'])
+
+    flags = 0
+    if version >= 2 and args['frame_index'] and not compress:
+        flags |= FLAG_FRAME_INDEX
+    if version >= 2 and args['packed_rects']:
+        flags |= FLAG_PACKED_RECTS
+    elif version >= 2 and args['rect_size']:
+        flags |= FLAG_RECT_SIZE
+    if version >= 2 and args['span_frames']:
+        flags |= FLAG_SPAN_FRAMES
+    if version >= 2 and args['tile_frames']:
+        flags |= FLAG_TILE_FRAMES
+    if version >= 2 and args['interlace']:
+        flags |= FLAG_INTERLACED
+    if compress:
+        flags |= FLAG_COMPRESSED
+
+        # The player can only get to a frame by decompressing everything before it.
+        if args['frame_index']:
+            print(f'{COL_YEL}- {COL_NONE} Compressed videos don\'t get a frame index.')
+
+    # Nothing touches the disk until it's all done, then it goes out
+    # in one write.
+    with io.BytesIO() as output:
         # Generate and write the Header
-        head = struct.pack('5sBBB', bytes(MAGIC, encoding='utf-8'), int(args['fps']), VERS,
-        int(args['scale_factor']))
+        if version == 1:
+            head = struct.pack('5sBBB', bytes(MAGIC, encoding='utf-8'), int(args['fps']), 1,
+            int(args['scale_factor']))
+        else:
+            head = struct.pack('5sBBBB', bytes(MAGIC, encoding='utf-8'), int(args['fps']), VERS,
+            int(args['scale_factor']), flags)
         output.write(head)
 
-        # Walk through all of the generated frames
-        i = 0
-        last_percent = 0
-        while i <= frames:
-            path = f'{TEMP_DIR_PATH}/frame{str(i)}.png'
+        jobs = int(args['jobs'])
+        if jobs > 1:
+            encoded_frames = encode_frames_in_parallel(images, keyframe_interval, jobs)
+        else:
+            encoded_frames = encode_frames(images, keyframe_interval)
 
-            # End if we're out of frames to process.
-            if not os.path.isfile(path):
-                print(f'{COL_RED}Error{COL_NONE}: Could not find frame {str(i)}.')
-                break
+        # Walk through all of the frames
+        last_percent = 0
+        frame_offsets = []
+        simplified = 0
+        held = 0
 
+        # Compressed videos go out a block of whole frames at a time, and
+        # AppVars can only be split between blocks.
+        block = bytearray()
+        block_offsets = []
+        unpacked_size = 0
+        packed_size = 0
+        i = 0
+        repeated = 0
+        start_time = time.perf_counter()
+        for frame_data, levels in merge_repeated_frames(encoded_frames):
             # Percentage status report
-            percent = int(100 * i/(frames - 1))
+            percent = min(100, int(100 * i/max(frames - 1, 1)))
 
             if percent % 10 == 0 and last_percent != percent:
                 print(f'{COL_BLUE}* {COL_NONE} Processing at {percent}%..')
                 last_percent = percent
 
-            # First, get the image in OpenCV
-            image_frame = cv2.imread(path)
-            # Then turn it into a 2D array
-            frame_array = image_to_array(image_frame)
-            # Now a list of Greedy-Meshed rectangles
-            greedy_frame = greedy_mesh_frame(frame_array)
-
-            # Now we can begin writing the frames,
-            # starting with the new frame identifier.
-            output.write(b'\xFF')
-
-            # Grab all of our rectangles
-            for rectangle in greedy_frame:
-                # Push 'em!
-                push_rectangle_to_file(rectangle, output)
+            if compress:
+                if len(block) > 0 and len(block) + len(frame_data) + 1 > block_size:
+                    block_offsets.append(output.tell())
+                    unpacked_size += len(block) + 1
+                    packed_size += write_compressed_block(output, bytes(block + CHUNK_END))
+                    block = bytearray()
+                block += frame_data
+            else:
+                # The index goes by frame times, repeats are on for several.
+                frame_offsets += [output.tell()] * len(levels)
+                output.write(frame_data)
 
-            i += 1
+            repeat = version >= 2 and frame_data[1] == FRAME_TYPE_REPEAT
+            for level in levels:
+                if level > RATE_CONTROL_LEVELS:
+                    held += 1
+                elif level > 0:
+                    simplified += 1
+                elif repeat:
+                    repeated += 1
+            i += len(levels)
 
         # Report end of file and close it.
         print(f'{COL_BLUE}* {COL_NONE} Finished frame processing.')
-        output.write(b'\xFE')
-        output.close()
+
+        seconds = max(time.perf_counter() - start_time, 0.001)
+        print(f'{COL_BLUE}* {COL_NONE} Encoded {i} frames in {seconds:.1f}s, {i / seconds:.1f} frames/sec.')
+
+        if repeated > 0:
+            print(f'{COL_BLUE}* {COL_NONE} {repeated} frames were repeats of the one before.')
+
+        if simplified > 0 or held > 0:
+            print(f'{COL_YEL}- {COL_NONE} Rate control simplified {simplified} frames and held back {held}.')
+
+        if compress:
+            block_offsets.append(output.tell())
+            unpacked_size += len(block) + 1
+            packed_size += write_compressed_block(output, bytes(block + b'\xFE'))
+
+            print(f'{COL_BLUE}* {COL_NONE} Compressed {len(block_offsets)} blocks down to '
+            f'{100 * packed_size / max(unpacked_size, 1):.1f}%.')
+        else:
+            output.write(b'\xFE')
+
+        if flags & FLAG_FRAME_INDEX:
+            write_frame_index(output, frame_offsets)
+
+        return output.getvalue(), block_offsets if compress else frame_offsets
+
+def write_c_header(path, data):
+    '''
+    Writes data out as a C header to build into the player, laid
+    out like xxd -i's output pasted into the README's template.
+    '''
+    hex_bytes = [f'0x{byte:02x}' for byte in range(256)]
+    lines = (', '.join(hex_bytes[byte] for byte in data[i:i + 12]) for i in range(0, len(data), 12))
+
+    with open(path, 'w', newline='\n') as header:
+        header.write('#ifdef _VID84_H_\n#error There is already an 84VID header included in the build.\n#endif\n\n')
+        header.write('#ifndef _VID84_H_\n#define _VID84_H_\n\n')
+        header.write('unsigned char video_bin[] = {\n  ' + ',\n  '.join(lines) + '\n};\n')
+        header.write(f'unsigned int video_bin_len = {len(data)};\n\n\n#endif // _VID84_H_\n')
+
+def write_appvar(path, name, data):
+    '''
+    Writes data out as an archived TI-84 Plus CE AppVar
+    (.8xv) file, ready to be sent over with TI-Connect/tilp.
+    '''
+    var_data = len(data).to_bytes(2, byteorder='little') + data
+
+    entry = struct.pack('<HHB8sBBH', 13, len(var_data), APPVAR_TYPE,
+    bytes(name, encoding='ascii'), 0, 0x80, len(var_data)) + var_data
+    checksum = sum(entry) & 0xFFFF
+
+    with open(path, 'wb') as appvar:
+        appvar.write(b'**TI83F*\x1A\x0A\x00')
+        appvar.write(bytes('84VID video data', encoding='ascii').ljust(42, b'\x00'))
+        appvar.write(len(entry).to_bytes(2, byteorder='little'))
+        appvar.write(entry)
+        appvar.write(checksum.to_bytes(2, byteorder='little'))
+
+def split_84vid_into_appvars(data, frame_offsets, name, directory):
+    '''
+    Splits the encoded video into as few AppVars as it fits in,
+    named <name>00, <name>01, and so on, and writes them into
+    directory. Splits only ever happen between frames (or between
+    frame index entries) so the player never has to stitch a
+    frame back together. frame_offsets are where the frames start,
+    or where the blocks of a compressed video do, which can't be
+    split up either.
+    '''
+    name = name.upper()
+
+    # Places we're allowed to split at. Everything after the
+    # end code is the frame index, which is split on entries.
+    end_code = len(data) - 1
+    if data[6] >= 2 and data[8] & FLAG_FRAME_INDEX:
+        end_code = len(data) - 4 - len(frame_offsets) * 3
+
+    if data[6] >= 2 and data[8] & FLAG_COMPRESSED:
+        split_points = frame_offsets[1:]
+    else:
+        split_points = frame_offsets[1:] + [end_code]
+        split_points += list(range(end_code + 1, len(data) - 2, 3))
+
+    chunks = []
+    start = 0
+    point = 0
+    while len(data) - start > APPVAR_MAX_SIZE:
+        # Take as much as fits, leaving room for the chunk end.
+        split = None
+        while point < len(split_points) and split_points[point] - start < APPVAR_MAX_SIZE:
+            split = split_points[point]
+            point += 1
+
+        if split is None or split == start:
+            print(f'{COL_RED}Error{COL_NONE}: A frame is too big to fit in an AppVar.')
+            sys.exit()
+
+        chunks.append(data[start:split] + CHUNK_END)
+        start = split
+
+    chunks.append(data[start:])
+
+    if len(chunks) > 100:
+        print(f'{COL_RED}Error{COL_NONE}: Video needs {len(chunks)} AppVars, only 100 are allowed.')
+        sys.exit()
+
+    # Single AppVars keep the name they were given.
+    for i, chunk in enumerate(chunks):
+        chunk_name = name if len(chunks) == 1 else f'{name}{i:02d}'
+        write_appvar(os.path.join(directory, f'{chunk_name}.8xv'), chunk_name, chunk)
+
+    print(f'{COL_BLUE}* {COL_NONE} Wrote video as {len(chunks)} AppVar(s).')
+
+def write_encoded_video(data, frame_offsets):
+    '''
+    Writes the encoded video out as the output file's extension
+    asks: a C header for .h, AppVars named after the file for
+    .8xv, and the plain video for anything else. -a writes
+    AppVars on top of that.
+    '''
+    path = args['output_file']
+    base, extension = os.path.splitext(path)
+
+    if extension.lower() == '.h':
+        write_c_header(path, data)
+        print(f'{COL_BLUE}* {COL_NONE} Wrote video as header {path}.')
+    elif extension.lower() == '.8xv':
+        split_84vid_into_appvars(data, frame_offsets, os.path.basename(base), os.path.dirname(path))
+    else:
+        with open(path, 'wb') as output:
+            output.write(data)
+
+    if args['appvar_name'] is not None:
+        split_84vid_into_appvars(data, frame_offsets, args['appvar_name'], '')
 
 def fetch_cli_arguments():
     '''
     Initiates ArgParser with all potential command line arguments.
     '''
     global args
-    parser = argparse.ArgumentParser(description='Encoder for 84VID \'codec\' version 1 (one).')
+    parser = argparse.ArgumentParser(description='Encoder for 84VID \'codec\' versions 1 and 2.')
     parser.add_argument('-i', '--input-file',
                         help='OpenCV-supported input video file.', required=True)
     parser.add_argument('-o', '--output-file',
-                        help='File name for generated 84VID file.', default='video.bin')
+                        help='File name for generated 84VID file. Ending in .h writes a C header, .8xv AppVars named after it.',
+                        default='video.bin')
     parser.add_argument('-f', '--fps',
                         help='Desired output framerate for 84VID file.', default=30)
     parser.add_argument('-s', '--scale-factor',
@@ -300,6 +1440,60 @@ def fetch_cli_arguments():
                         help='0-255 color value threshold for white pixels', default=150)
     parser.add_argument('-cf', '--crop-frame',
                         help='Frame to use as reference for cropping. -1 for none.', default=0)
+    parser.add_argument('-cs', '--crop-samples',
+                        help='Crop to everything shown in this many frames spread over the video, instead of just -cf.',
+                        default=0)
+    parser.add_argument('-fv', '--format-version',
+                        help='84VID format version to write. 2 adds delta frames.',
+                        choices=['1', '2'], default=str(VERS))
+    parser.add_argument('-ki', '--keyframe-interval',
+                        help='Seconds between forced keyframes in version 2 files. 0 for none.',
+                        default=10)
+    parser.add_argument('--frame-index', action=argparse.BooleanOptionalAction,
+                        help='Append a frame offset index for seeking (version 2 only).',
+                        default=True)
+    parser.add_argument('--rect-size', action=argparse.BooleanOptionalAction,
+                        help='Store rectangle sizes instead of far corners (version 2 only).',
+                        default=True)
+    parser.add_argument('--packed-rects', action=argparse.BooleanOptionalAction,
+                        help='Store rectangles relative to the one before, in 2-5 bytes instead of 4. Overrides --rect-size (version 2 only).',
+                        default=True)
+    parser.add_argument('--span-frames', action=argparse.BooleanOptionalAction,
+                        help='Store frames as row spans when that is smaller (version 2 only).',
+                        default=True)
+    parser.add_argument('--tile-frames', action=argparse.BooleanOptionalAction,
+                        help='Store changes as 16x16 tiles to clear and redraw when that is fewer fills (version 2 only).',
+                        default=True)
+    parser.add_argument('-il', '--interlace', action='store_true',
+                        help='Alternate between the even and odd rows of each frame, with -f counting those fields (version 2 only).')
+    parser.add_argument('-om', '--optimize-mesh', action='store_true',
+                        help='Try a few slower ways of meshing each frame, and keep the one the player draws quickest.')
+    parser.add_argument('-z', '--compress', action='store_true',
+                        help='Compress the video in blocks of frames, for the player to decompress as it goes (version 2 only).')
+    parser.add_argument('--block-size',
+                        help='Compression: most bytes of frames per block. The player keeps three in RAM.',
+                        default=4096)
+    parser.add_argument('-rc', '--rate-control', action='store_true',
+                        help='Simplify frames until the player can draw each one within its frame time.')
+    parser.add_argument('--cost-per-frame',
+                        help='Rate control: player time spent on every frame, in microseconds.', default=500)
+    parser.add_argument('--cost-per-fill',
+                        help='Rate control: player time per rectangle or span, in microseconds.', default=40)
+    parser.add_argument('--cost-per-pixel',
+                        help='Rate control: player time per pixel filled, in microseconds.', default=0.02)
+    parser.add_argument('--cost-per-copy',
+                        help='Rate control: player time spent bringing the frame on screen into the back buffer under a delta, in microseconds. 0 for single-buffered players.',
+                        default=2000)
+    parser.add_argument('-j', '--jobs',
+                        help='Number of worker processes to encode frames with.', default=1)
+    parser.add_argument('--reference-frames',
+                        help='Also write every frame as the player should show it, for decoder/host\'s bench -r.',
+                        default=None)
+    parser.add_argument('--temp-frames', action='store_true',
+                        help='Debugging: go through .PNG frames in temp/ instead of straight from memory.')
+    parser.add_argument('-a', '--appvar-name',
+                        help='Also split the video into archived AppVars with this name (up to 6 characters).',
+                        default=None)
     args = vars(parser.parse_args())
 
 def print_banner():
@@ -307,13 +1501,13 @@ def print_banner():
     Prints a cute banner :^)
     '''
     print('==================')
-    print('84VID ENCODER V1.0')
+    print('84VID ENCODER V2.0')
     print('==================')
 
 def main():
     '''
     Goes through the list of actions required to successfully
-    encode an OpenCV-compatible video file into an 84VID 1.0
+    encode an OpenCV-compatible video file into an 84VID
     encoded video.
     '''
     fetch_cli_arguments()
@@ -323,8 +1517,35 @@ def main():
         print(f'{COL_RED}Error{COL_NONE}: Input video file does not exist. Exiting.')
         sys.exit()
 
-    frames = convert_video_to_image_sequence()
-    encode_images_to_84vid(frames)
+    # AppVar names have to start with a letter, and we need the
+    # last two characters for numbering.
+    base, extension = os.path.splitext(os.path.basename(args['output_file']))
+    names = [args['appvar_name']] if args['appvar_name'] is not None else []
+    if extension.lower() == '.8xv':
+        names.append(base)
+
+    if any(not re.fullmatch('[A-Z][A-Z0-9]{0,5}', name.upper()) for name in names):
+        print(f'{COL_RED}Error{COL_NONE}: AppVar name must be 1-6 letters/numbers, starting with a letter.')
+        sys.exit()
+
+    # Interlaced videos play fields, two to a frame.
+    interlaced = args['interlace'] and int(args['format_version']) >= 2
+    max_fps = MAX_FIELD_RATE if interlaced else MAX_FPS
+    if int(args['fps']) > max_fps:
+        print(f'{COL_RED}Error{COL_NONE}: The player can\'t go faster than {max_fps} {"fields" if interlaced else "frames"} per second.')
+        sys.exit()
+
+    capture, fps_rate = open_video_capture()
+
+    if args['temp_frames']:
+        frames = convert_video_to_image_sequence(capture, fps_rate)
+        images = read_image_sequence(frames)
+    else:
+        frames = int(capture.get(cv2.CAP_PROP_FRAME_COUNT) / fps_rate)
+        images = read_video_frames(capture, fps_rate)
+
+    data, frame_offsets = encode_images_to_84vid(images, frames)
+    write_encoded_video(data, frame_offsets)
 
     print(f'{COL_GREEN}Done!{COL_NONE} 😃')
     sys.exit()